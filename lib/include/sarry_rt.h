@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SARRY_RT_H_
+#define SARRY_RT_H_
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/sarry.h>
+
+/* Locks guarding first use of cached arrays */
+#define SARRY_NLOCK 16
+
+/* Arrays with at least this many blocks inflate in parallel */
+#define SARRY_PAR_BLOCKS 16
+
+/* Most threads used for one array */
+#define SARRY_MAXTHREADS 8
+
+/* Most arrays mapped with sarry_map() at once */
+#define SARRY_NLAZY 64
+
+/*
+ * A .static_array section opened for reading. Only
+ * the index is checked when it is opened, arrays are
+ * inflated when they are first asked for.
+ *
+ * @base: Section contents.
+ * @size: Size of the section.
+ * @hdr: Section header.
+ * @ents: Index, sorted by hash.
+ * @cache: Inflated copy of each array (or NULL).
+ * @maps: Demand paged view of each array (or NULL).
+ * @map: Mapped file, if opened from one.
+ * @maplen: Length of `map'.
+ * @locks: Serialize filling `cache'.
+ */
+struct sarry_ctx {
+    const char *base;
+    size_t size;
+    const struct sarry_hdr *hdr;
+    const struct sarry_ent *ents;
+    void **cache;
+    void **maps;
+    void *map;
+    size_t maplen;
+    pthread_mutex_t locks[SARRY_NLOCK];
+};
+
+int sarry_attach(struct sarry_ctx *cp, const void *sec, size_t size);
+int sarry_open(struct sarry_ctx *cp, const char *path);
+void sarry_close(struct sarry_ctx *cp);
+struct sarry_ctx *sarry_self(void);
+
+const struct sarry_ent *sarry_find(const struct sarry_ctx *cp,
+    const char *name);
+ssize_t sarry_read(struct sarry_ctx *cp, const struct sarry_ent *ep,
+    void *buf, size_t off, size_t len);
+const void *sarry_get(struct sarry_ctx *cp, const struct sarry_ent *ep);
+const void *sarry_map(struct sarry_ctx *cp, const struct sarry_ent *ep);
+
+#endif  /* !SARRY_RT_H_ */
@@ -0,0 +1,773 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Runtime side of static arrays. Finds the
+ * .static_array section of an image, looks arrays
+ * up by name through its index and inflates them,
+ * either into caller memory a range at a time, into
+ * a copy that is made on first use and kept, or one
+ * block at a time as the pages of a reserved range
+ * are first touched.
+ */
+
+#define _GNU_SOURCE
+#include <sys/errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ldo/elf.h>
+#include <sarry_rt.h>
+#include <lz4.h>
+
+/*
+ * One thread's share of a parallel read.
+ */
+struct read_job {
+    struct sarry_ctx *cp;
+    const struct sarry_ent *ep;
+    char *dst;
+    size_t first;
+    size_t last;
+    int err;
+    int started;
+    pthread_t td;
+};
+
+/*
+ * An array mapped with sarry_map(), looked up by
+ * the fault handler without taking any lock.
+ *
+ * @base: Start of the reserved range (NULL if the slot is free).
+ * @len: Length of the range.
+ * @cp: Context the array is in.
+ * @ep: Array.
+ * @done: Set per block once it has been mapped in.
+ */
+struct sarry_lazy {
+    char *base;
+    size_t len;
+    struct sarry_ctx *cp;
+    const struct sarry_ent *ep;
+    uint8_t *done;
+};
+
+static struct sarry_lazy lazy[SARRY_NLAZY];
+static pthread_mutex_t lazy_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t lazy_once = PTHREAD_ONCE_INIT;
+static struct sigaction lazy_old;
+static unsigned int lazy_busy;
+static int lazy_err;
+
+static struct sarry_ctx self;
+static int self_err;
+static pthread_once_t self_once = PTHREAD_ONCE_INIT;
+
+static inline const uint64_t *
+sarry_blocks(const struct sarry_ctx *cp, const struct sarry_ent *ep)
+{
+    return (const uint64_t *)(cp->base + ep->blocks);
+}
+
+/*
+ * Returns the size of block `i' of an array
+ * once inflated.
+ */
+static inline size_t
+sarry_blen(const struct sarry_ctx *cp, const struct sarry_ent *ep, size_t i)
+{
+    size_t bs = cp->hdr->block_size;
+
+    if (i == ep->nblock - 1)
+        return ep->real_size - i * bs;
+    return bs;
+}
+
+/*
+ * Inflate block `i' of an array into `dst',
+ * which must hold the whole block.
+ */
+static int
+sarry_block(const struct sarry_ctx *cp, const struct sarry_ent *ep, size_t i,
+    char *dst)
+{
+    const uint64_t *blocks = sarry_blocks(cp, ep);
+    size_t blen = sarry_blen(cp, ep, i);
+    size_t clen = blocks[i + 1] - blocks[i];
+    const char *src = cp->base + blocks[i];
+
+    if (clen == blen) {
+        memcpy(dst, src, blen);
+        return 0;
+    }
+
+    if (LZ4_decompress_safe(src, dst, clen, blen) != (int)blen)
+        return -EIO;
+    return 0;
+}
+
+/*
+ * Check that an index entry stays within the
+ * section, so reads never have to.
+ */
+static int
+sarry_ent_chk(const struct sarry_ctx *cp, const struct sarry_ent *ep)
+{
+    const uint64_t *blocks;
+    uint64_t bs = cp->hdr->block_size;
+    size_t i;
+
+    if (ep->name >= cp->size)
+        return -1;
+    if (memchr(cp->base + ep->name, '\0', cp->size - ep->name) == NULL)
+        return -1;
+    if (ep->nblock != ep->real_size / bs + (ep->real_size % bs != 0))
+        return -1;
+    if ((ep->blocks & 7) != 0 || ep->blocks > cp->size)
+        return -1;
+    if ((cp->size - ep->blocks) / sizeof(*blocks) < ep->nblock + 1ULL)
+        return -1;
+
+    blocks = sarry_blocks(cp, ep);
+    for (i = 0; i < ep->nblock; ++i) {
+        if (blocks[i] > blocks[i + 1] || blocks[i + 1] > cp->size)
+            return -1;
+        if (blocks[i + 1] - blocks[i] > sarry_blen(cp, ep, i))
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Read a .static_array section already in memory,
+ * such as one found through the program headers.
+ * `sec' must stay valid until sarry_close().
+ *
+ * @cp: Context to set up.
+ * @sec: Section contents.
+ * @size: Size of the section.
+ */
+int
+sarry_attach(struct sarry_ctx *cp, const void *sec, size_t size)
+{
+    const struct sarry_hdr *hdr = sec;
+    size_t i;
+
+    memset(cp, 0, sizeof(*cp));
+    if (size < sizeof(*hdr) || ((uintptr_t)sec & 7) != 0)
+        return -EINVAL;
+    if (hdr->magic == __builtin_bswap32(SARRY_MAGIC))
+        return -ENOEXEC;
+    if (hdr->magic != SARRY_MAGIC || hdr->version != SARRY_VERSION)
+        return -EINVAL;
+    if (hdr->codec != SARRY_CODEC_LZ4 || hdr->block_size == 0)
+        return -ENOTSUP;
+    if (hdr->size > size)
+        return -EINVAL;
+    if ((hdr->size - sizeof(*hdr)) / sizeof(*cp->ents) < hdr->narray)
+        return -EINVAL;
+
+    cp->base = sec;
+    cp->size = hdr->size;
+    cp->hdr = hdr;
+    cp->ents = (const struct sarry_ent *)(hdr + 1);
+
+    for (i = 0; i < hdr->narray; ++i) {
+        if (sarry_ent_chk(cp, &cp->ents[i]) < 0)
+            return -EINVAL;
+    }
+
+    cp->cache = calloc(hdr->narray + 1, sizeof(*cp->cache));
+    cp->maps = calloc(hdr->narray + 1, sizeof(*cp->maps));
+    if (cp->cache == NULL || cp->maps == NULL) {
+        free(cp->cache);
+        free(cp->maps);
+        cp->cache = NULL;
+        cp->maps = NULL;
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < SARRY_NLOCK; ++i) {
+        pthread_mutex_init(&cp->locks[i], NULL);
+    }
+
+    return 0;
+}
+
+/*
+ * Map an ELF image and read its .static_array
+ * section.
+ *
+ * @cp: Context to set up.
+ * @path: Image pathname.
+ */
+int
+sarry_open(struct sarry_ctx *cp, const char *path)
+{
+    const Elf64_Ehdr *eh;
+    const Elf64_Shdr *shdrs, *shstr;
+    struct stat st;
+    const char *map;
+    size_t i;
+    int fd, err = -ENOENT;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0) {
+        err = -errno;
+        close(fd);
+        return err;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -errno;
+
+    eh = (const Elf64_Ehdr *)map;
+    if ((size_t)st.st_size < sizeof(*eh) ||
+        memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_shentsize != sizeof(*shdrs) ||
+        eh->e_shoff > (size_t)st.st_size ||
+        ((size_t)st.st_size - eh->e_shoff) / sizeof(*shdrs) < eh->e_shnum ||
+        eh->e_shstrndx >= eh->e_shnum) {
+        err = -ENOEXEC;
+        goto fail;
+    }
+
+    shdrs = (const Elf64_Shdr *)(map + eh->e_shoff);
+    shstr = &shdrs[eh->e_shstrndx];
+    for (i = 0; i < eh->e_shnum; ++i) {
+        if (shdrs[i].sh_name >= shstr->sh_size ||
+            shstr->sh_offset + shstr->sh_size > (size_t)st.st_size)
+            continue;
+        if (strncmp(map + shstr->sh_offset + shdrs[i].sh_name, SARRY_SECTION,
+            shstr->sh_size - shdrs[i].sh_name) != 0)
+            continue;
+        if (shdrs[i].sh_offset + shdrs[i].sh_size > (size_t)st.st_size)
+            break;
+
+        err = sarry_attach(cp, map + shdrs[i].sh_offset, shdrs[i].sh_size);
+        if (err < 0)
+            goto fail;
+        cp->map = (void *)map;
+        cp->maplen = st.st_size;
+        return 0;
+    }
+
+fail:
+    munmap((void *)map, st.st_size);
+    return err;
+}
+
+/*
+ * Drop a range mapped by sarry_map(). The handler
+ * stops looking at it first, then any fault already
+ * past that check is waited out before the range and
+ * its block map go away.
+ */
+static void
+lazy_unmap(void *base)
+{
+    struct sarry_lazy *lp;
+    size_t i;
+
+    pthread_mutex_lock(&lazy_lock);
+    for (i = 0; i < SARRY_NLAZY; ++i) {
+        lp = &lazy[i];
+        if (lp->base != base)
+            continue;
+
+        __atomic_store_n(&lp->base, NULL, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&lazy_busy, __ATOMIC_SEQ_CST) != 0) {
+            sched_yield();
+        }
+        munmap(base, lp->len);
+        free(lp->done);
+        lp->done = NULL;
+        break;
+    }
+    pthread_mutex_unlock(&lazy_lock);
+}
+
+/*
+ * Release a context and every array cached
+ * through it.
+ *
+ * @cp: Context to close.
+ */
+void
+sarry_close(struct sarry_ctx *cp)
+{
+    size_t i;
+
+    if (cp->cache != NULL) {
+        for (i = 0; i < cp->hdr->narray; ++i) {
+            free(cp->cache[i]);
+            if (cp->maps[i] != NULL)
+                lazy_unmap(cp->maps[i]);
+        }
+        for (i = 0; i < SARRY_NLOCK; ++i) {
+            pthread_mutex_destroy(&cp->locks[i]);
+        }
+    }
+
+    if (cp->map != NULL)
+        munmap(cp->map, cp->maplen);
+
+    free(cp->cache);
+    free(cp->maps);
+    memset(cp, 0, sizeof(*cp));
+}
+
+static void
+sarry_self_init(void)
+{
+    self_err = sarry_open(&self, "/proc/self/exe");
+}
+
+/*
+ * Returns the static arrays of the running program,
+ * opened once on first call, or NULL with errno set
+ * if it has none.
+ */
+struct sarry_ctx *
+sarry_self(void)
+{
+    pthread_once(&self_once, sarry_self_init);
+    if (self_err < 0) {
+        errno = -self_err;
+        return NULL;
+    }
+
+    return &self;
+}
+
+/*
+ * Look up an array by name, returns NULL if
+ * there is none.
+ *
+ * @cp: Context to look in.
+ * @name: Array name.
+ */
+const struct sarry_ent *
+sarry_find(const struct sarry_ctx *cp, const char *name)
+{
+    const struct sarry_ent *ep;
+    uint64_t h = sarry_hash(name);
+    size_t lo = 0, hi = cp->hdr->narray, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (cp->ents[mid].hash < h) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (; lo < cp->hdr->narray; ++lo) {
+        ep = &cp->ents[lo];
+        if (ep->hash != h)
+            break;
+        if (strcmp(cp->base + ep->name, name) == 0)
+            return ep;
+    }
+
+    return NULL;
+}
+
+static void *
+read_work(void *arg)
+{
+    struct read_job *jp = arg;
+    size_t i, bs = jp->cp->hdr->block_size;
+
+    for (i = jp->first; i < jp->last; ++i) {
+        if (sarry_block(jp->cp, jp->ep, i, jp->dst + (i - jp->first) * bs) < 0) {
+            jp->err = -EIO;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Inflate the whole blocks `first' up to `last'
+ * into `dst', split over threads if there are
+ * enough of them.
+ */
+static int
+sarry_blocks_read(struct sarry_ctx *cp, const struct sarry_ent *ep,
+    char *dst, size_t first, size_t last)
+{
+    struct read_job jobs[SARRY_MAXTHREADS];
+    size_t i, n, per, bs = cp->hdr->block_size;
+    long ncpu;
+    int err = 0;
+
+    n = 1;
+    if (last - first >= SARRY_PAR_BLOCKS) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n = (ncpu > 1) ? ncpu : 1;
+        if (n > SARRY_MAXTHREADS)
+            n = SARRY_MAXTHREADS;
+    }
+
+    per = (last - first + n - 1) / n;
+    for (i = 0; i < n; ++i) {
+        jobs[i].cp = cp;
+        jobs[i].ep = ep;
+        jobs[i].first = first + i * per;
+        jobs[i].last = jobs[i].first + per;
+        if (jobs[i].last > last)
+            jobs[i].last = last;
+        if (jobs[i].first > jobs[i].last)
+            jobs[i].first = jobs[i].last;
+        jobs[i].dst = dst + (jobs[i].first - first) * bs;
+        jobs[i].err = 0;
+    }
+
+    for (i = 1; i < n; ++i) {
+        jobs[i].started = pthread_create(&jobs[i].td, NULL, read_work,
+            &jobs[i]) == 0;
+    }
+
+    read_work(&jobs[0]);
+    for (i = 1; i < n; ++i) {
+        /* Do its share here if the thread never started */
+        if (jobs[i].started) {
+            pthread_join(jobs[i].td, NULL);
+        } else {
+            read_work(&jobs[i]);
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (jobs[i].err < 0)
+            err = jobs[i].err;
+    }
+
+    return err;
+}
+
+/*
+ * Inflate the part of block `i' that overlaps
+ * `off' up to `end' into `buf', which holds the
+ * read starting at `off'.
+ */
+static int
+sarry_partial(struct sarry_ctx *cp, const struct sarry_ent *ep, size_t i,
+    char *buf, size_t off, size_t end, char *tmp)
+{
+    size_t bs = cp->hdr->block_size;
+    size_t start = i * bs, stop = start + sarry_blen(cp, ep, i);
+
+    if (sarry_block(cp, ep, i, tmp) < 0)
+        return -EIO;
+
+    if (start < off)
+        start = off;
+    if (stop > end)
+        stop = end;
+    memcpy(buf + (start - off), tmp + (start - i * bs), stop - start);
+    return 0;
+}
+
+/*
+ * Inflate part of an array into caller memory,
+ * only the blocks the range touches are read.
+ * Returns the number of bytes read, which is
+ * short at the end of the array.
+ *
+ * @cp: Context the array is in.
+ * @ep: Array, from sarry_find().
+ * @buf: Buffer to fill.
+ * @off: Offset in the array to start at.
+ * @len: Number of bytes to read.
+ */
+ssize_t
+sarry_read(struct sarry_ctx *cp, const struct sarry_ent *ep, void *buf,
+    size_t off, size_t len)
+{
+    size_t bs = cp->hdr->block_size;
+    size_t end, lo, hi;
+    char *tmp = NULL;
+    int err = 0;
+
+    if (off >= ep->real_size)
+        return 0;
+    if (len > ep->real_size - off)
+        len = ep->real_size - off;
+    if (len == 0)
+        return 0;
+
+    end = off + len;
+    lo = off / bs;
+    hi = (end + bs - 1) / bs;
+
+    /* Blocks cut by either end of the range go through `tmp' */
+    if (off > lo * bs || end < lo * bs + sarry_blen(cp, ep, lo) ||
+        end < (hi - 1) * bs + sarry_blen(cp, ep, hi - 1)) {
+        if ((tmp = malloc(bs)) == NULL)
+            return -ENOMEM;
+    }
+
+    if (off > lo * bs || end < lo * bs + sarry_blen(cp, ep, lo)) {
+        err = sarry_partial(cp, ep, lo, buf, off, end, tmp);
+        ++lo;
+    }
+    if (err == 0 && hi > lo &&
+        end < (hi - 1) * bs + sarry_blen(cp, ep, hi - 1)) {
+        err = sarry_partial(cp, ep, hi - 1, buf, off, end, tmp);
+        --hi;
+    }
+    if (err == 0 && hi > lo)
+        err = sarry_blocks_read(cp, ep, (char *)buf + (lo * bs - off), lo, hi);
+
+    free(tmp);
+    return (err < 0) ? err : (ssize_t)len;
+}
+
+/*
+ * Returns an inflated copy of an array, made on
+ * first use and shared by every later caller, or
+ * NULL with errno set on failure. Safe to call
+ * from any thread.
+ *
+ * @cp: Context the array is in.
+ * @ep: Array, from sarry_find().
+ */
+const void *
+sarry_get(struct sarry_ctx *cp, const struct sarry_ent *ep)
+{
+    size_t idx = ep - cp->ents;
+    pthread_mutex_t *lock = &cp->locks[idx % SARRY_NLOCK];
+    ssize_t err;
+    void *p;
+
+    if ((p = __atomic_load_n(&cp->cache[idx], __ATOMIC_ACQUIRE)) != NULL)
+        return p;
+
+    pthread_mutex_lock(lock);
+    if ((p = cp->cache[idx]) != NULL)
+        goto done;
+
+    if ((p = malloc(ep->real_size ? ep->real_size : 1)) == NULL) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    if ((err = sarry_read(cp, ep, p, 0, ep->real_size)) < 0) {
+        free(p);
+        p = NULL;
+        errno = -err;
+        goto done;
+    }
+
+    __atomic_store_n(&cp->cache[idx], p, __ATOMIC_RELEASE);
+done:
+    pthread_mutex_unlock(lock);
+    return p;
+}
+
+/*
+ * Inflate block `i' of a mapped array off to the
+ * side and move it into place in one step, so no
+ * other thread ever sees it half written. Two
+ * threads faulting on the same block both do this,
+ * which is harmless as the contents are the same.
+ */
+static int
+lazy_fill(struct sarry_lazy *lp, size_t i)
+{
+    size_t bs = lp->cp->hdr->block_size;
+    void *tmp, *dst = lp->base + i * bs;
+
+    tmp = mmap(NULL, bs, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0);
+    if (tmp == MAP_FAILED)
+        return -1;
+
+    if (sarry_block(lp->cp, lp->ep, i, tmp) < 0 ||
+        mprotect(tmp, bs, PROT_READ) < 0 ||
+        mremap(tmp, bs, bs, MREMAP_MAYMOVE | MREMAP_FIXED, dst) == MAP_FAILED) {
+        munmap(tmp, bs);
+        return -1;
+    }
+
+    __atomic_store_n(&lp->done[i], 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * SIGSEGV handler, fills in the block of a mapped
+ * array that was touched. Anything else, including
+ * writes to a filled block, goes to the handler that
+ * was there before.
+ */
+static void
+lazy_fault(int sig, siginfo_t *si, void *uctx)
+{
+    struct sarry_lazy *lp;
+    char *addr = si->si_addr, *base;
+    size_t i, blk;
+    int saved = errno;
+
+    /* Holds off lazy_unmap() until the slot is let go */
+    __atomic_add_fetch(&lazy_busy, 1, __ATOMIC_SEQ_CST);
+    for (i = 0; i < SARRY_NLAZY; ++i) {
+        lp = &lazy[i];
+        base = __atomic_load_n(&lp->base, __ATOMIC_SEQ_CST);
+        if (base == NULL || addr < base || addr >= base + lp->len)
+            continue;
+
+        blk = (addr - base) / lp->cp->hdr->block_size;
+        if (blk < lp->ep->nblock &&
+            !__atomic_load_n(&lp->done[blk], __ATOMIC_ACQUIRE) &&
+            lazy_fill(lp, blk) == 0) {
+            __atomic_sub_fetch(&lazy_busy, 1, __ATOMIC_SEQ_CST);
+            errno = saved;
+            return;
+        }
+        break;
+    }
+
+    __atomic_sub_fetch(&lazy_busy, 1, __ATOMIC_SEQ_CST);
+    errno = saved;
+    if ((lazy_old.sa_flags & SA_SIGINFO) != 0) {
+        lazy_old.sa_sigaction(sig, si, uctx);
+    } else if (lazy_old.sa_handler != SIG_DFL &&
+        lazy_old.sa_handler != SIG_IGN) {
+        lazy_old.sa_handler(sig);
+    } else {
+        /* Faults again on return, this time fatally */
+        signal(sig, SIG_DFL);
+    }
+}
+
+static void
+lazy_init(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = lazy_fault;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGSEGV, &sa, &lazy_old) < 0)
+        lazy_err = -errno;
+}
+
+/*
+ * Returns a read-only view of an array that takes
+ * no memory up front. Each block is inflated the
+ * first time one of its pages is touched, so sparse
+ * lookups into a huge table only pay for what they
+ * use. Returns NULL with errno set on failure.
+ *
+ * This installs a SIGSEGV handler the first time
+ * it is used, a handler installed after that must
+ * pass on faults it does not handle itself.
+ *
+ * @cp: Context the array is in.
+ * @ep: Array, from sarry_find().
+ */
+const void *
+sarry_map(struct sarry_ctx *cp, const struct sarry_ent *ep)
+{
+    struct sarry_lazy *lp = NULL;
+    size_t i, len, idx = ep - cp->ents, bs = cp->hdr->block_size;
+    long pgsz = sysconf(_SC_PAGESIZE);
+    char *base;
+    void *p;
+
+    if ((p = __atomic_load_n(&cp->maps[idx], __ATOMIC_ACQUIRE)) != NULL)
+        return p;
+
+    /* Blocks have to line up with pages */
+    if (bs % pgsz != 0) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    pthread_once(&lazy_once, lazy_init);
+    if (lazy_err < 0) {
+        errno = -lazy_err;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lazy_lock);
+    if ((p = cp->maps[idx]) != NULL)
+        goto done;
+
+    for (i = 0; i < SARRY_NLAZY; ++i) {
+        if (lazy[i].base == NULL) {
+            lp = &lazy[i];
+            break;
+        }
+    }
+
+    if (lp == NULL) {
+        errno = ENOSPC;
+        goto done;
+    }
+
+    len = ep->nblock ? ep->nblock * bs : (size_t)pgsz;
+    base = mmap(NULL, len, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        goto done;
+
+    if ((lp->done = calloc(ep->nblock + 1, 1)) == NULL) {
+        munmap(base, len);
+        errno = ENOMEM;
+        goto done;
+    }
+
+    lp->len = len;
+    lp->cp = cp;
+    lp->ep = ep;
+    __atomic_store_n(&lp->base, base, __ATOMIC_RELEASE);
+
+    p = base;
+    __atomic_store_n(&cp->maps[idx], p, __ATOMIC_RELEASE);
+done:
+    pthread_mutex_unlock(&lazy_lock);
+    return p;
+}
@@ -0,0 +1,568 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Static archive support. Only the symbol index and long
+ * name table are looked at up front, members are loaded
+ * lazily when the index says they define a symbol that is
+ * still undefined. Regular members are parsed in place as
+ * views of the archive buffer, thin archive members are
+ * opened from their own files.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/archive.h>
+#include <ldo/hash.h>
+#include <ldo/cdefs.h>
+
+/* Symbol states */
+#define SYM_UNDEF   0x0001
+#define SYM_DEF     0x0002
+
+/*
+ * Global symbol as seen by the archive loader.
+ *
+ * @name: Symbol name.
+ * @state: SYM_* state.
+ */
+struct ar_sym {
+    const char *name;
+    int state;
+};
+
+/*
+ * Global symbols of every loaded object.
+ *
+ * @slots: Hash table (open addressing).
+ * @nslots: Number of slots.
+ * @count: Number of symbols.
+ */
+struct ar_symtab {
+    struct ar_sym *slots;
+    size_t nslots;
+    size_t count;
+};
+
+static uint64_t
+ar_be(const unsigned char *p, size_t n)
+{
+    uint64_t v = 0;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+/*
+ * Parse a space padded decimal header field.
+ */
+static int
+ar_field(const char *p, size_t n, uint64_t *res)
+{
+    uint64_t v = 0;
+    size_t i;
+
+    for (i = 0; i < n && p[i] != ' '; ++i) {
+        if (p[i] < '0' || p[i] > '9')
+            return -EINVAL;
+        v = v * 10 + (p[i] - '0');
+    }
+
+    *res = v;
+    return 0;
+}
+
+/*
+ * Returns true if a file starts with an
+ * archive magic.
+ *
+ * @lfp: File to check.
+ */
+int
+ldo_isarchive(const struct ldo_file *lfp)
+{
+    const char *p = LDO_BUFSTREAM(lfp->data);
+
+    if (lfp->file_size < SARMAG)
+        return 0;
+
+    return memcmp(p, ARMAG, SARMAG) == 0 || memcmp(p, THINMAG, SARMAG) == 0;
+}
+
+/*
+ * Look up the member header at `off' and return
+ * its size, or a negative value if it is bad.
+ */
+static int
+ar_member(struct ldo_archive *ar, size_t off, const struct ar_hdr **hdrp,
+    uint64_t *sizep)
+{
+    const struct ar_hdr *hdr;
+
+    if (off > ar->lfp->file_size ||
+        ar->lfp->file_size - off < sizeof(*hdr))
+        return -EINVAL;
+
+    hdr = (const struct ar_hdr *)(LDO_BUFSTREAM(ar->lfp->data) + off);
+    if (memcmp(hdr->ar_fmag, ARFMAG, 2) != 0)
+        return -EINVAL;
+    if (ar_field(hdr->ar_size, sizeof(hdr->ar_size), sizep) < 0)
+        return -EINVAL;
+
+    *hdrp = hdr;
+    return 0;
+}
+
+/*
+ * Index the archive symbol table, `offsz' is 4
+ * for "/" and 8 for "/SYM64/".
+ */
+static int
+ar_symidx(struct ldo_archive *ar, const char *p, uint64_t size, size_t offsz)
+{
+    const char *end = p + size;
+    uint64_t count;
+    size_t i;
+
+    if (size < offsz)
+        return -EINVAL;
+
+    count = ar_be((const unsigned char *)p, offsz);
+    if (count > (size - offsz) / offsz)
+        return -EINVAL;
+
+    ar->nsyms = count;
+    ar->offsz = offsz;
+    ar->offs = (const unsigned char *)p + offsz;
+    ar->names = calloc(count + 1, sizeof(*ar->names));
+    if (ar->names == NULL)
+        return -ENOMEM;
+
+    p += offsz + count * offsz;
+    for (i = 0; i < count; ++i) {
+        if (p >= end || memchr(p, '\0', end - p) == NULL)
+            return -EINVAL;
+        ar->names[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Index an archive, only the symbol index and long
+ * name table are looked at. The returned archive
+ * takes ownership of `lfp'.
+ *
+ * @pathname: Archive pathname.
+ * @lfp: Opened archive file.
+ */
+struct ldo_archive *
+ldo_archive_new(const char *pathname, struct ldo_file *lfp)
+{
+    struct ldo_archive *ar;
+    const struct ar_hdr *hdr;
+    const char *data;
+    uint64_t size;
+    size_t off;
+    int err = 0;
+
+    if ((ar = calloc(1, sizeof(*ar))) == NULL)
+        return NULL;
+
+    ar->pathname = pathname;
+    ar->lfp = lfp;
+    ar->thin = memcmp(LDO_BUFSTREAM(lfp->data), THINMAG, SARMAG) == 0;
+
+    /* Special members always come first */
+    off = SARMAG;
+    while (off < lfp->file_size) {
+        if ((err = ar_member(ar, off, &hdr, &size)) < 0)
+            break;
+
+        data = (const char *)(hdr + 1);
+        if (strncmp(hdr->ar_name, "/ ", 2) == 0) {
+            err = ar_symidx(ar, data, size, 4);
+        } else if (strncmp(hdr->ar_name, "/SYM64/ ", 8) == 0) {
+            err = ar_symidx(ar, data, size, 8);
+        } else if (strncmp(hdr->ar_name, "// ", 3) == 0) {
+            ar->lnames = data;
+            ar->lnsize = size;
+        } else {
+            break;
+        }
+
+        if (err < 0 || size > lfp->file_size - off - sizeof(*hdr)) {
+            err = -EINVAL;
+            break;
+        }
+
+        off += sizeof(*hdr) + size + (size & 1);
+    }
+
+    if (err < 0) {
+        fprintf(stderr, "ldo_archive_new: malformed archive \"%s\"\n",
+            pathname);
+        free(ar->names);
+        free(ar);
+        return NULL;
+    }
+
+    if (ar->names == NULL) {
+        fprintf(stderr, "[warn] \"%s\" has no symbol index (run ranlib)\n",
+            pathname);
+    }
+
+    vlog("archive: %s%s, %zu symbols\n", pathname, ar->thin ? " (thin)" : "",
+        ar->nsyms);
+    return ar;
+}
+
+/*
+ * Free an archive and its file, every member
+ * loaded from it must be freed first.
+ *
+ * @ar: Archive to free.
+ */
+void
+ldo_archive_free(struct ldo_archive *ar)
+{
+    size_t i;
+
+    if (ar == NULL)
+        return;
+
+    for (i = 0; i < ar->nstrs; ++i) {
+        free(ar->strs[i]);
+    }
+
+    ldo_close(ar->lfp);
+    free(ar->strs);
+    free(ar->names);
+    free(ar->loaded);
+    free(ar);
+}
+
+/*
+ * Keep a string for as long as the archive
+ * lives.
+ */
+static char *
+ar_keep(struct ldo_archive *ar, char *s)
+{
+    char **tmp;
+
+    if (s == NULL)
+        return NULL;
+
+    tmp = realloc(ar->strs, (ar->nstrs + 1) * sizeof(*tmp));
+    if (tmp == NULL) {
+        free(s);
+        return NULL;
+    }
+
+    ar->strs = tmp;
+    ar->strs[ar->nstrs++] = s;
+    return s;
+}
+
+/*
+ * Copy out the name of a member.
+ */
+static int
+ar_name(struct ldo_archive *ar, const struct ar_hdr *hdr, char *buf,
+    size_t len)
+{
+    const char *p, *end;
+    uint64_t lnoff;
+    size_t n = 0;
+
+    if (hdr->ar_name[0] == '/' && hdr->ar_name[1] >= '0' &&
+        hdr->ar_name[1] <= '9') {
+        if (ar_field(&hdr->ar_name[1], sizeof(hdr->ar_name) - 1, &lnoff) < 0)
+            return -EINVAL;
+        if (ar->lnames == NULL || lnoff >= ar->lnsize)
+            return -EINVAL;
+
+        p = ar->lnames + lnoff;
+        end = ar->lnames + ar->lnsize;
+        while (p + n < end && p[n] != '/' && p[n] != '\n')
+            ++n;
+    } else {
+        p = hdr->ar_name;
+        while (n < sizeof(hdr->ar_name) && p[n] != '/' && p[n] != ' ')
+            ++n;
+    }
+
+    if (n >= len)
+        return -ENAMETOOLONG;
+
+    memcpy(buf, p, n);
+    buf[n] = '\0';
+    return 0;
+}
+
+/*
+ * Load the member whose header is at `off'.
+ */
+static struct ldo_input *
+ar_load(struct ldo_archive *ar, size_t off)
+{
+    const struct ar_hdr *hdr;
+    struct ldo_input *in;
+    struct ldo_file *lfp;
+    char name[4096], path[8192];
+    const char *slash;
+    char *label;
+    uint64_t size;
+    int dirlen;
+
+    if (ar_member(ar, off, &hdr, &size) < 0 ||
+        ar_name(ar, hdr, name, sizeof(name)) < 0) {
+        fprintf(stderr, "ldo: bad member at %zu in \"%s\"\n", off, ar->pathname);
+        return NULL;
+    }
+
+    snprintf(path, sizeof(path), "%s(%s)", ar->pathname, name);
+    if ((label = ar_keep(ar, strdup(path))) == NULL)
+        return NULL;
+
+    if (!ar->thin) {
+        lfp = ldo_view(ar->lfp, off + sizeof(*hdr), size);
+    } else {
+        /* Thin members are relative to the archive */
+        slash = strrchr(ar->pathname, '/');
+        dirlen = (slash != NULL && name[0] != '/') ? slash - ar->pathname : 0;
+        snprintf(path, sizeof(path), "%.*s%s%s", dirlen, ar->pathname,
+            dirlen ? "/" : "", name);
+        lfp = ldo_open(path, O_RDONLY);
+    }
+
+    if (lfp == NULL) {
+        fprintf(stderr, "ldo: failed to read %s\n", label);
+        return NULL;
+    }
+
+    if ((in = ldo_load_obj(label, lfp)) == NULL)
+        fprintf(stderr, "ldo: failed to load %s\n", label);
+    return in;
+}
+
+/*
+ * Mark a member as loaded, returns 0 if
+ * it already was.
+ */
+static int
+ar_mark(struct ldo_archive *ar, uint64_t off)
+{
+    size_t mask = ar->nloaded - 1;
+    size_t i;
+
+    i = ldo_hash_mix(off, 0) & mask;
+    while (ar->loaded[i] != 0) {
+        if (ar->loaded[i] == off + 1)
+            return 0;
+        i = (i + 1) & mask;
+    }
+
+    ar->loaded[i] = off + 1;
+    return 1;
+}
+
+static struct ar_sym *
+sym_slot(struct ar_symtab *st, const char *name)
+{
+    size_t mask = st->nslots - 1;
+    size_t i;
+
+    i = ldo_hash64(name, strlen(name), 0) & mask;
+    while (st->slots[i].name != NULL) {
+        if (strcmp(st->slots[i].name, name) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &st->slots[i];
+}
+
+static int
+sym_grow(struct ar_symtab *st)
+{
+    struct ar_symtab nst;
+    struct ar_sym *sp;
+    size_t i;
+
+    nst.nslots = st->nslots ? st->nslots * 2 : 1024;
+    nst.count = st->count;
+    nst.slots = calloc(nst.nslots, sizeof(*nst.slots));
+    if (nst.slots == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < st->nslots; ++i) {
+        if (st->slots[i].name == NULL)
+            continue;
+        sp = sym_slot(&nst, st->slots[i].name);
+        *sp = st->slots[i];
+    }
+
+    free(st->slots);
+    *st = nst;
+    return 0;
+}
+
+/*
+ * Add the global symbols of an input. Weak
+ * references never pull members in.
+ */
+static int
+sym_add(struct ar_symtab *st, struct ldo_input *in)
+{
+    const Elf64_Sym *sym;
+    struct ar_sym *sp;
+    const char *name;
+    size_t i;
+
+    for (i = 1; i < in->nsym; ++i) {
+        sym = &in->syms[i];
+        if (ELF64_ST_BIND(sym->st_info) == STB_LOCAL)
+            continue;
+        name = ldo_input_symname(in, i);
+        if (*name == '\0')
+            continue;
+
+        if ((st->count + 1) * 2 > st->nslots && sym_grow(st) < 0)
+            return -ENOMEM;
+
+        sp = sym_slot(st, name);
+        if (sp->name == NULL) {
+            sp->name = name;
+            ++st->count;
+        }
+
+        if (sym->st_shndx != SHN_UNDEF) {
+            sp->state = SYM_DEF;
+        } else if (sp->state == 0 && ELF64_ST_BIND(sym->st_info) != STB_WEAK) {
+            sp->state = SYM_UNDEF;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Load every archive member needed to define the
+ * undefined symbols of the loaded inputs. Archives
+ * are rescanned until nothing new gets pulled in so
+ * their order on the command line does not matter.
+ * Fails if a member that is needed does not load.
+ *
+ * @iq: Loaded inputs, members are added here.
+ * @aq: Archives to search.
+ */
+int
+ldo_archive_resolve(struct ldo_inputq *iq, struct ldo_archiveq *aq)
+{
+    struct ldo_archive *ar;
+    struct ldo_input *in;
+    struct ar_symtab st;
+    struct ar_sym *sp;
+    size_t i, nload = 0, nsym = 0;
+    uint64_t off;
+    int changed, err = 0;
+
+    if (aq->count == 0)
+        return 0;
+
+    /* Size for every symbol of the loaded inputs up front */
+    memset(&st, 0, sizeof(st));
+    st.nslots = 1024;
+    TAILQ_FOREACH(in, &iq->q, link) {
+        nsym += in->nsym;
+    }
+    while (st.nslots < nsym * 2)
+        st.nslots <<= 1;
+    if ((st.slots = calloc(st.nslots, sizeof(*st.slots))) == NULL)
+        return -ENOMEM;
+
+    TAILQ_FOREACH(in, &iq->q, link) {
+        if ((err = sym_add(&st, in)) < 0)
+            goto done;
+    }
+
+    TAILQ_FOREACH(ar, &aq->q, link) {
+        ar->nloaded = 16;
+        while (ar->nloaded < ar->nsyms * 2)
+            ar->nloaded <<= 1;
+        free(ar->loaded);
+        ar->loaded = calloc(ar->nloaded, sizeof(*ar->loaded));
+        if (ar->loaded == NULL) {
+            err = -ENOMEM;
+            goto done;
+        }
+    }
+
+    do {
+        changed = 0;
+        TAILQ_FOREACH(ar, &aq->q, link) {
+            for (i = 0; i < ar->nsyms; ++i) {
+                sp = sym_slot(&st, ar->names[i]);
+                if (sp->name == NULL || sp->state != SYM_UNDEF)
+                    continue;
+
+                off = ar_be(ar->offs + i * ar->offsz, ar->offsz);
+                if (!ar_mark(ar, off))
+                    continue;
+                if ((in = ar_load(ar, off)) == NULL) {
+                    fprintf(stderr, "ldo: \"%s\" needs a member of \"%s\" "
+                        "that did not load\n", sp->name, ar->pathname);
+                    err = -EINVAL;
+                    goto done;
+                }
+                if ((err = sym_add(&st, in)) < 0)
+                    goto done;
+
+                ++nload;
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    vlog("archive: loaded %zu members\n", nload);
+done:
+    free(st.slots);
+    return err;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <ldo/bswap.h>
+
+/*
+ * Swap an array of 64-bit words. This is a plain
+ * loop on purpose, compilers turn it into vector
+ * shuffles on every host we build for.
+ *
+ * @p: Words to swap.
+ * @n: Number of words.
+ */
+void
+ldo_bswap_words(uint64_t *p, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        p[i] = ldo_bswap64(p[i]);
+    }
+}
+
+/*
+ * Swap every field of an ELF header, e_ident
+ * is made of bytes and stays as is.
+ */
+void
+ldo_bswap_ehdr(Elf64_Ehdr *eh)
+{
+    eh->e_type = ldo_bswap16(eh->e_type);
+    eh->e_machine = ldo_bswap16(eh->e_machine);
+    eh->e_version = ldo_bswap32(eh->e_version);
+    eh->e_entry = ldo_bswap64(eh->e_entry);
+    eh->e_phoff = ldo_bswap64(eh->e_phoff);
+    eh->e_shoff = ldo_bswap64(eh->e_shoff);
+    eh->e_flags = ldo_bswap32(eh->e_flags);
+    eh->e_ehsize = ldo_bswap16(eh->e_ehsize);
+    eh->e_phentsize = ldo_bswap16(eh->e_phentsize);
+    eh->e_phnum = ldo_bswap16(eh->e_phnum);
+    eh->e_shentsize = ldo_bswap16(eh->e_shentsize);
+    eh->e_shnum = ldo_bswap16(eh->e_shnum);
+    eh->e_shstrndx = ldo_bswap16(eh->e_shstrndx);
+}
+
+void
+ldo_bswap_shdrs(Elf64_Shdr *shdrs, size_t n)
+{
+    Elf64_Shdr *shdr;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        shdr = &shdrs[i];
+        shdr->sh_name = ldo_bswap32(shdr->sh_name);
+        shdr->sh_type = ldo_bswap32(shdr->sh_type);
+        shdr->sh_flags = ldo_bswap64(shdr->sh_flags);
+        shdr->sh_addr = ldo_bswap64(shdr->sh_addr);
+        shdr->sh_offset = ldo_bswap64(shdr->sh_offset);
+        shdr->sh_size = ldo_bswap64(shdr->sh_size);
+        shdr->sh_link = ldo_bswap32(shdr->sh_link);
+        shdr->sh_info = ldo_bswap32(shdr->sh_info);
+        shdr->sh_addralign = ldo_bswap64(shdr->sh_addralign);
+        shdr->sh_entsize = ldo_bswap64(shdr->sh_entsize);
+    }
+}
+
+void
+ldo_bswap_phdrs(Elf64_Phdr *phdrs, size_t n)
+{
+    Elf64_Phdr *phdr;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        phdr = &phdrs[i];
+        phdr->p_type = ldo_bswap32(phdr->p_type);
+        phdr->p_flags = ldo_bswap32(phdr->p_flags);
+        phdr->p_offset = ldo_bswap64(phdr->p_offset);
+        phdr->p_vaddr = ldo_bswap64(phdr->p_vaddr);
+        phdr->p_paddr = ldo_bswap64(phdr->p_paddr);
+        phdr->p_filesz = ldo_bswap64(phdr->p_filesz);
+        phdr->p_memsz = ldo_bswap64(phdr->p_memsz);
+        phdr->p_align = ldo_bswap64(phdr->p_align);
+    }
+}
+
+void
+ldo_bswap_syms(Elf64_Sym *syms, size_t n)
+{
+    Elf64_Sym *sym;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        sym = &syms[i];
+        sym->st_name = ldo_bswap32(sym->st_name);
+        sym->st_shndx = ldo_bswap16(sym->st_shndx);
+        sym->st_value = ldo_bswap64(sym->st_value);
+        sym->st_size = ldo_bswap64(sym->st_size);
+    }
+}
+
+/*
+ * A relocation is three 64-bit words, so the
+ * whole table goes through the word swapper.
+ */
+void
+ldo_bswap_relas(Elf64_Rela *relas, size_t n)
+{
+    ldo_bswap_words((uint64_t *)relas, n * 3);
+}
+
+void
+ldo_bswap_nhdr(Elf64_Nhdr *nhdr)
+{
+    nhdr->n_namesz = ldo_bswap32(nhdr->n_namesz);
+    nhdr->n_descsz = ldo_bswap32(nhdr->n_descsz);
+    nhdr->n_type = ldo_bswap32(nhdr->n_type);
+}
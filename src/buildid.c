@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Build ID hashing. The image is cut into fixed size chunks
+ * which are hashed on every thread, then the chunk digests
+ * are combined pairwise up a binary tree. Both the chunk size
+ * and the shape of the tree are fixed so the result is the
+ * same no matter how many threads did the work.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ldo/buildid.h>
+#include <ldo/hash.h>
+#include <ldo/thread.h>
+
+/*
+ * @buf: Image being hashed.
+ * @len: Length of the image.
+ * @digest: One digest per tree node of the current level.
+ * @next: Digests of the level being computed.
+ * @n: Number of nodes in the current level.
+ */
+struct bid_state {
+    const unsigned char *buf;
+    size_t len;
+    uint64_t *digest;
+    uint64_t *next;
+    size_t n;
+};
+
+static void
+bid_leaf_work(size_t idx, void *arg)
+{
+    struct bid_state *sp = arg;
+    size_t off, len;
+
+    off = idx * (size_t)LDO_BUILDID_CHUNK;
+    len = sp->len - off;
+    if (len > LDO_BUILDID_CHUNK)
+        len = LDO_BUILDID_CHUNK;
+
+    sp->digest[idx] = ldo_hash64(sp->buf + off, len, idx);
+}
+
+static void
+bid_node_work(size_t idx, void *arg)
+{
+    struct bid_state *sp = arg;
+    uint64_t l, r;
+
+    l = sp->digest[idx * 2];
+    r = (idx * 2 + 1 < sp->n) ? sp->digest[idx * 2 + 1] : 0;
+    sp->next[idx] = ldo_hash_mix(l, r);
+}
+
+/*
+ * Compute the build ID of an image, stored most
+ * significant byte first whatever the host.
+ *
+ * @buf: Image to hash.
+ * @len: Length of the image.
+ * @id: Where to put the LDO_BUILDID_SIZE byte ID.
+ */
+int
+ldo_build_id(const void *buf, size_t len, uint8_t *id)
+{
+    struct bid_state st;
+    uint64_t *tmp;
+    uint64_t h;
+    size_t i, n;
+
+    st.buf = buf;
+    st.len = len;
+    st.n = (len + LDO_BUILDID_CHUNK - 1) / LDO_BUILDID_CHUNK;
+    if (st.n == 0)
+        st.n = 1;
+
+    /* Way too big for the stack on large images */
+    st.digest = calloc(st.n, sizeof(*st.digest));
+    st.next = calloc((st.n + 1) / 2, sizeof(*st.next));
+    if (st.digest == NULL || st.next == NULL) {
+        free(st.digest);
+        free(st.next);
+        return -ENOMEM;
+    }
+
+    ldo_parallel_for(st.n, bid_leaf_work, &st);
+
+    /* Reduce one level of the tree at a time */
+    while (st.n > 1) {
+        n = (st.n + 1) / 2;
+        ldo_parallel_for(n, bid_node_work, &st);
+        tmp = st.digest;
+        st.digest = st.next;
+        st.next = tmp;
+        st.n = n;
+    }
+
+    h = ldo_hash_mix(st.digest[0], len);
+    for (i = 0; i < LDO_BUILDID_SIZE; ++i) {
+        id[i] = h >> (8 * (LDO_BUILDID_SIZE - 1 - i));
+    }
+
+    free(st.digest);
+    free(st.next);
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Section compression. With --compress-debug-sections
+ * every .debug_* output section is deflated into an
+ * SHF_COMPRESSED section behind an Elf64_Chdr, one
+ * section per work item.
+ *
+ * Compressed input sections (-gz) go the other way,
+ * they are inflated straight into wherever they are
+ * copied to, by whichever worker copies them.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/compress.h>
+#include <ldo/input.h>
+#include <ldo/bswap.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+#include <zlib.h>
+
+/*
+ * Compression state.
+ *
+ * @osecs: Sections to compress.
+ * @data: Byte order of the output (ELFDATA*).
+ * @err: Set by any work item that fails.
+ */
+struct zdebug_ctx {
+    struct ldo_osec **osecs;
+    uint8_t data;
+    int err;
+};
+
+/*
+ * Copy the contents of an input section to `dst',
+ * inflating them if the section is compressed.
+ * `dst' must have room for `isp->size' bytes.
+ *
+ * @isp: Input section (with data).
+ * @dst: Where to put the contents.
+ */
+int
+ldo_isec_copy(const struct ldo_isec *isp, void *dst)
+{
+    uLongf len = isp->size;
+    int zerr;
+
+    if (isp->zsize == 0) {
+        memcpy(dst, isp->data, isp->size);
+        return 0;
+    }
+
+    zerr = uncompress((Bytef *)dst, &len, (const Bytef *)isp->data,
+        isp->zsize);
+    if (zerr != Z_OK || len != isp->size) {
+        fprintf(stderr, "ldo: %s: %s: bad compressed section\n",
+            isp->in->pathname, isp->name);
+        return -ENOEXEC;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns true if an output section should
+ * be compressed.
+ */
+static int
+zdebug_wanted(const struct ldo_osec *osp)
+{
+    if ((osp->flags & (SHF_ALLOC | SHF_COMPRESSED)) != 0)
+        return 0;
+    if (osp->type != SHT_PROGBITS || osp->data != NULL)
+        return 0;
+    if (strncmp(osp->name, ".debug", 6) != 0)
+        return 0;
+
+    return osp->size > sizeof(Elf64_Chdr);
+}
+
+/*
+ * Compress one output section, runs on the
+ * worker pool. Sections that do not shrink
+ * are left alone.
+ */
+static void
+zdebug_work(size_t idx, void *arg)
+{
+    struct zdebug_ctx *ctx = arg;
+    struct ldo_osec *osp = ctx->osecs[idx];
+    struct ldo_isec *isp;
+    Elf64_Chdr *chdr;
+    uLongf clen;
+    char *raw, *buf;
+    size_t i;
+    int err;
+
+    raw = calloc(1, osp->size);
+    clen = compressBound(osp->size);
+    buf = malloc(sizeof(*chdr) + clen);
+    if (raw == NULL || buf == NULL) {
+        __atomic_store_n(&ctx->err, -ENOMEM, __ATOMIC_RELAXED);
+        goto done;
+    }
+
+    for (i = 0; i < osp->nisec; ++i) {
+        isp = osp->isecs[i];
+        if (isp->data == NULL)
+            continue;
+        if ((err = ldo_isec_copy(isp, raw + isp->off)) < 0) {
+            __atomic_store_n(&ctx->err, err, __ATOMIC_RELAXED);
+            goto done;
+        }
+    }
+
+    /* Link speed is the point, favour it over size */
+    if (compress2((Bytef *)(buf + sizeof(*chdr)), &clen, (Bytef *)raw,
+        osp->size, Z_BEST_SPEED) != Z_OK)
+        goto done;
+    if (sizeof(*chdr) + clen >= osp->size)
+        goto done;
+
+    chdr = (Elf64_Chdr *)buf;
+    chdr->ch_type = ELFCOMPRESS_ZLIB;
+    chdr->ch_reserved = 0;
+    chdr->ch_size = osp->size;
+    chdr->ch_addralign = osp->align;
+    if (ctx->data != LDO_HOST_DATA) {
+        chdr->ch_type = ldo_bswap32(chdr->ch_type);
+        chdr->ch_size = ldo_bswap64(chdr->ch_size);
+        chdr->ch_addralign = ldo_bswap64(chdr->ch_addralign);
+    }
+
+    osp->data = buf;
+    osp->buf = buf;
+    osp->real_size = osp->size;
+    osp->size = sizeof(*chdr) + clen;
+    osp->align = 8;
+    osp->flags |= SHF_COMPRESSED;
+    buf = NULL;
+done:
+    free(raw);
+    free(buf);
+}
+
+static int
+zdebug_cmp(const void *a, const void *b)
+{
+    const struct ldo_osec *oa = *(struct ldo_osec *const *)a;
+    const struct ldo_osec *ob = *(struct ldo_osec *const *)b;
+
+    return (oa->size < ob->size) - (oa->size > ob->size);
+}
+
+/*
+ * Compress every .debug_* output section, called
+ * once sections are sized but before they are
+ * given offsets.
+ *
+ * @op: Output image.
+ * @data: Byte order of the output (ELFDATA*).
+ */
+int
+ldo_compress_debug(struct ldo_output *op, uint8_t data)
+{
+    struct zdebug_ctx ctx;
+    size_t i, n = 0, before = 0, after = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.data = data;
+    if ((ctx.osecs = calloc(op->nosec + 1, sizeof(*ctx.osecs))) == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < op->nosec; ++i) {
+        if (zdebug_wanted(&op->osecs[i])) {
+            ctx.osecs[n++] = &op->osecs[i];
+            before += op->osecs[i].size;
+        }
+    }
+
+    /* Largest first so one big section does not finish last */
+    qsort(ctx.osecs, n, sizeof(*ctx.osecs), zdebug_cmp);
+    ldo_parallel_for(n, zdebug_work, &ctx);
+    for (i = 0; i < n; ++i) {
+        after += ctx.osecs[i]->size;
+    }
+
+    free(ctx.osecs);
+    if (ctx.err == -ENOMEM)
+        fprintf(stderr, "ldo_compress_debug: out of memory\n");
+    if (ctx.err < 0)
+        return ctx.err;
+
+    vlog("compress-debug: %zu sections, %zu -> %zu bytes\n", n, before,
+        after);
+    return 0;
+}
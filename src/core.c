@@ -28,12 +28,29 @@
  */
 
 #include <sys/errno.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <ldo/ldo.h>
 #include <ldo/file.h>
 #include <ldo/elf.h>
 #include <ldo/object.h>
+#include <ldo/input.h>
+#include <ldo/icf.h>
+#include <ldo/state.h>
+#include <ldo/server.h>
+#include <ldo/archive.h>
+#include <ldo/output.h>
+#include <ldo/manifest.h>
+#include <ldo/thread.h>
+#include <ldo/bswap.h>
+#include <ldo/uring.h>
+#include <ldo/order.h>
 #include <ldo/cdefs.h>
 #include <lz4.h>
 
@@ -47,7 +64,53 @@
 #endif  /* !defined(__PPC64__) */
 #endif  /* defined(__ppc64__) || ... */
 
+/*
+ * An input being loaded by ldo_load_all().
+ *
+ * @ent: Manifest entry.
+ * @in: Parsed object (or NULL).
+ * @ar: Parsed archive (or NULL).
+ * @lfp: Input read ahead of time (or NULL).
+ * @warm: `in' came from the server cache.
+ * @err: Why the input could not be loaded (or 0).
+ */
+struct load_job {
+    const struct ldo_mfent *ent;
+    struct ldo_input *in;
+    struct ldo_archive *ar;
+    struct ldo_file *lfp;
+    int warm;
+    int err;
+};
+
+/*
+ * Everything ldo_load_all() hands the workers.
+ *
+ * @jobs: One job per manifest entry.
+ * @order: Job indices, largest input first.
+ * @n: Number of entries in `order'.
+ * @base: Index in `order' of the batch being parsed.
+ * @batched: Inputs are read in batches by load_batch().
+ * @window: How many inputs to read ahead.
+ * @ahead: Inputs in `order' hinted so far.
+ * @io_ns: Time spent reading inputs, summed over threads.
+ * @cpu_ns: Time spent parsing inputs, summed over threads.
+ */
+struct load_ctx {
+    struct load_job *jobs;
+    size_t *order;
+    size_t n;
+    size_t base;
+    int batched;
+    size_t window;
+    size_t ahead;
+    uint64_t io_ns;
+    uint64_t cpu_ns;
+};
+
 static struct sarry_objq objq;
+static struct ldo_inputq inputq;
+static struct ldo_archiveq archq;
 
 /*
  * Machine string map, LDO machine defines
@@ -101,7 +164,7 @@ ldo_elf64_mach(const Elf64_Ehdr *eh)
     case EM_X86_64:
         return LDO_X86_64;
     case EM_AARCH64:
-        return LDO_X86_64;
+        return LDO_AARCH64;
     case EM_PPC64:
         return LDO_PPC64;
     }
@@ -110,73 +173,569 @@ ldo_elf64_mach(const Elf64_Ehdr *eh)
 }
 
 /*
- * Perform preliminary checks on the ELF header
- * and warn/error as needed.
+ * Load the first eight bytes of e_ident as one
+ * word, they hold the magic, class, data encoding
+ * and version.
  */
-static inline int
-ldo_elf64_chk(const Elf64_Ehdr *eh)
+static inline uint64_t
+ldo_ident_word(const unsigned char *ident)
 {
-    ldo_mach_t target, current;
-    const char *tstr, *cstr;
+    uint64_t word;
 
-    /* Ensure magic is correct */
-    if (eh->e_ident[EI_MAG0] != ELFMAG0)
-        return -ENOEXEC;
-    if (eh->e_ident[EI_MAG1] != ELFMAG1)
+    memcpy(&word, ident, sizeof(word));
+    return word;
+}
+
+/*
+ * Check everything about an ELF header and its section
+ * header table that later phases rely on, in one pass,
+ * and fill in a descriptor they can trust. Cheap checks
+ * go first so files that are not ELF at all are turned
+ * away after a single compare.
+ *
+ * Objects in the foreign byte order have their header
+ * and section header table swapped in place here, so
+ * a same-endian link never pays for it.
+ *
+ * Returns -ENOEXEC if this is not a 64-bit ELF object,
+ * -ENOTSUP if it is one but not relocatable and -EINVAL
+ * if it is malformed.
+ *
+ * @lfp: Object file.
+ * @dp: Returns the validated descriptor.
+ */
+static int
+ldo_elf64_chk(struct ldo_file *lfp, struct ldo_elfdesc *dp)
+{
+    static const unsigned char ident[2][8] = {
+        { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB,
+          EV_CURRENT, 0 },
+        { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2MSB,
+          EV_CURRENT, 0 }
+    };
+    static const unsigned char identmask[8] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00
+    };
+    Elf64_Ehdr *eh;
+    const Elf64_Shdr *sh0;
+    char *base = LDO_BUFSTREAM(lfp->data);
+    size_t file_size = lfp->file_size;
+    ldo_mach_t current;
+    uint64_t word, mask, shsize;
+
+    if (file_size < sizeof(*eh))
         return -ENOEXEC;
-    if (eh->e_ident[EI_MAG2] != ELFMAG2)
+
+    eh = (Elf64_Ehdr *)base;
+    mask = ldo_ident_word(identmask);
+    word = ldo_ident_word(eh->e_ident) & mask;
+
+    if (word == ldo_ident_word(ident[0])) {
+        dp->data = ELFDATA2LSB;
+    } else if (word == ldo_ident_word(ident[1])) {
+        dp->data = ELFDATA2MSB;
+    } else {
         return -ENOEXEC;
-    if (eh->e_ident[EI_MAG3] != ELFMAG3)
+    }
+
+    /* SysV or GNU ABI, then ABI version 0 and zero padding */
+    if (eh->e_ident[EI_OSABI] != ELFOSABI_NONE &&
+        eh->e_ident[EI_OSABI] != ELFOSABI_GNU)
         return -ENOEXEC;
+    if (ldo_ident_word(&eh->e_ident[EI_ABIVERSION]) != 0)
+        return -EINVAL;
+
+    if (__unlikely(dp->data != LDO_HOST_DATA))
+        ldo_bswap_ehdr(eh);
+
+    if (eh->e_type != ET_REL)
+        return -ENOTSUP;
+    if (eh->e_version != EV_CURRENT || eh->e_ehsize < sizeof(*eh))
+        return -EINVAL;
+
+    dp->eh = eh;
+    dp->shdrs = NULL;
+    dp->nsec = eh->e_shnum;
+    dp->shstrndx = eh->e_shstrndx;
+    dp->mach = ldo_elf64_mach(eh);
+
+    /* Nothing reads program headers, but they must be in the file */
+    if (eh->e_phnum != 0) {
+        if (eh->e_phentsize != sizeof(Elf64_Phdr))
+            return -EINVAL;
+        if (eh->e_phoff > file_size || (uint64_t)eh->e_phnum *
+            sizeof(Elf64_Phdr) > file_size - eh->e_phoff)
+            return -EINVAL;
+    }
+
+    if (eh->e_shoff != 0) {
+        if (eh->e_shentsize != sizeof(Elf64_Shdr) || (eh->e_shoff & 7) != 0)
+            return -EINVAL;
+        if (eh->e_shoff > file_size ||
+            file_size - eh->e_shoff < sizeof(Elf64_Shdr))
+            return -EINVAL;
 
-    target = ldo_elf64_mach(eh);
-    current = ldo_elf64_mach(eh);
+        /* Counts too big for the ELF header are kept in section 0 */
+        sh0 = (const Elf64_Shdr *)(base + eh->e_shoff);
+        if (dp->nsec == 0) {
+            dp->nsec = sh0->sh_size;
+            if (__unlikely(dp->data != LDO_HOST_DATA))
+                dp->nsec = ldo_bswap64(sh0->sh_size);
+        }
+        if (dp->shstrndx == SHN_XINDEX) {
+            dp->shstrndx = sh0->sh_link;
+            if (__unlikely(dp->data != LDO_HOST_DATA))
+                dp->shstrndx = ldo_bswap32(sh0->sh_link);
+        }
+    }
+
+    if (dp->nsec != 0) {
+        if (eh->e_shoff == 0 || dp->nsec > file_size / sizeof(Elf64_Shdr))
+            return -EINVAL;
+        shsize = (uint64_t)dp->nsec * sizeof(Elf64_Shdr);
+        if (shsize > file_size - eh->e_shoff)
+            return -EINVAL;
+        if (dp->shstrndx >= dp->nsec)
+            return -EINVAL;
+        dp->shdrs = (const Elf64_Shdr *)(base + eh->e_shoff);
+        if (__unlikely(dp->data != LDO_HOST_DATA))
+            ldo_bswap_shdrs((Elf64_Shdr *)dp->shdrs, dp->nsec);
+    }
 
-    tstr = ldo_machstr(target);
-    cstr = ldo_machstr(current);
-    vlog("target=%s, current=%s\n", tstr, cstr);
+    current = getmach();
+    vlog("target=%s, current=%s\n", ldo_machstr(dp->mach),
+        ldo_machstr(current));
 
-    if (target != current) {
-        fprintf(stdout, "warn: target %s will not run on %s\n", tstr, cstr);
+    if (dp->mach != current) {
+        fprintf(stdout, "warn: target %s will not run on %s\n",
+            ldo_machstr(dp->mach), ldo_machstr(current));
     }
 
     return 0;
 }
 
-void
-ldo_load(const char *pathname)
+/*
+ * Check and index an ELF object. Takes ownership
+ * of `lfp' and returns the new input or NULL.
+ *
+ * @pathname: Name to refer to the object by.
+ * @lfp: Object file.
+ */
+static struct ldo_input *
+ldo_parse_obj(const char *pathname, struct ldo_file *lfp)
 {
-    Elf64_Ehdr *eh;
-    struct ldo_file *lfp;
+    struct ldo_elfdesc desc;
+    struct ldo_input *in;
     int err;
 
-    if ((lfp = ldo_open(pathname, O_RDONLY)) == NULL) {
-        fprintf(stderr, "ldo_load: failed to open \"%s\"\n", pathname);
-        return;
-    }
-
-    eh = (Elf64_Ehdr *)LDO_BUFSTREAM(lfp->data);
-    err = ldo_elf64_chk(eh);
+    err = ldo_elf64_chk(lfp, &desc);
 
     /* Make sure our checks went fine */
     if (err == -ENOEXEC) {
-        fprintf(stderr, "ldo_load: bad magic for \"%s\"\n", pathname);
-        return;
+        fprintf(stderr, "ldo_load: \"%s\" is not a 64-bit ELF object\n",
+            pathname);
+        ldo_close(lfp);
+        return NULL;
+    }
+    if (err == -ENOTSUP) {
+        fprintf(stderr, "ldo_load: \"%s\" is not a relocatable object\n",
+            pathname);
+        ldo_close(lfp);
+        return NULL;
     }
     if (err < 0) {
-        fprintf(stderr, "ldo_load: failed to load obj (retval=%d)\n", err);
+        fprintf(stderr, "ldo_load: malformed ELF header in \"%s\"\n",
+            pathname);
+        ldo_close(lfp);
+        return NULL;
+    }
+
+    vlog("entrypoint=0x%llx\n", desc.eh->e_entry);
+    vlog("program headers: %d\n", desc.eh->e_phnum);
+    vlog("section headers: %zu\n", desc.nsec);
+
+    if ((in = ldo_input_new(pathname, lfp, &desc)) == NULL) {
+        ldo_close(lfp);
+        return NULL;
+    }
+
+    return in;
+}
+
+/*
+ * Add a parsed object to the inputs of this link.
+ */
+static void
+ldo_add_obj(struct ldo_input *in)
+{
+    ldo_state_apply(in);
+    TAILQ_INSERT_TAIL(&inputq.q, in, link);
+    ++inputq.count;
+}
+
+/*
+ * Check and index an ELF object, then add it to
+ * the inputs of this link. Takes ownership of `lfp'
+ * and returns the new input or NULL.
+ *
+ * @pathname: Name to refer to the object by.
+ * @lfp: Object file.
+ */
+struct ldo_input *
+ldo_load_obj(const char *pathname, struct ldo_file *lfp)
+{
+    struct ldo_input *in;
+
+    if ((in = ldo_parse_obj(pathname, lfp)) != NULL)
+        ldo_add_obj(in);
+
+    return in;
+}
+
+static inline uint64_t
+load_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Ask the kernel to start reading an input into the
+ * page cache without waiting for it.
+ */
+static void
+load_hint(const char *pathname)
+{
+    int fd;
+
+    if ((fd = open(pathname, O_RDONLY)) < 0)
+        return;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+/*
+ * Make sure every input up to `upto' in load order
+ * has had its read ahead started. Whichever worker
+ * gets there first claims each input, so nothing is
+ * hinted twice.
+ */
+static void
+load_prefetch(struct load_ctx *ctx, size_t upto)
+{
+    size_t cur;
+
+    if (upto > ctx->n)
+        upto = ctx->n;
+
+    cur = __atomic_load_n(&ctx->ahead, __ATOMIC_RELAXED);
+    while (cur < upto) {
+        if (!__atomic_compare_exchange_n(&ctx->ahead, &cur, cur + 1, 0,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            continue;
+
+        load_hint(ctx->jobs[ctx->order[cur]].ent->pathname);
+        ++cur;
+    }
+}
+
+/*
+ * Open and parse a single input, runs on
+ * the worker pool.
+ */
+static void
+load_work(size_t idx, void *arg)
+{
+    struct load_ctx *ctx = arg;
+    struct load_job *job;
+    const char *pathname;
+    struct ldo_file *lfp;
+    uint64_t start, mid;
+
+    idx += ctx->base;
+    job = &ctx->jobs[ctx->order[idx]];
+    pathname = job->ent->pathname;
+
+    /* Keep the disk busy with what comes next */
+    if (ctx->window != 0)
+        load_prefetch(ctx, idx + 1 + ctx->window);
+
+    start = load_now();
+    lfp = ctx->batched ? job->lfp : ldo_open(pathname, O_RDONLY);
+    mid = load_now();
+    __atomic_fetch_add(&ctx->io_ns, mid - start, __ATOMIC_RELAXED);
+
+    if (lfp == NULL) {
+        fprintf(stderr, "ldo_load: failed to open \"%s\"\n", pathname);
+        job->err = -EIO;
         return;
     }
 
-    vlog("entrypoint=0x%llx\n", eh->e_entry);
-    vlog("program headers: %d\n", eh->e_phnum);
-    vlog("section headers: %d\n", eh->e_shnum);
-    ldo_close(lfp);
+    if (!ldo_isarchive(lfp)) {
+        if ((job->in = ldo_parse_obj(pathname, lfp)) == NULL)
+            job->err = -EINVAL;
+    } else if ((job->ar = ldo_archive_new(pathname, lfp)) == NULL) {
+        ldo_close(lfp);
+        job->err = -EINVAL;
+    }
+
+    __atomic_fetch_add(&ctx->cpu_ns, load_now() - mid, __ATOMIC_RELAXED);
 }
 
+/*
+ * Open and read a batch of inputs through io_uring,
+ * then parse them on the worker pool.
+ *
+ * @ctx: Load context.
+ * @base: Index in `order' of the first input.
+ * @n: Number of inputs, at most LDO_URING_BATCH.
+ */
+static void
+load_batch(struct load_ctx *ctx, size_t base, size_t n)
+{
+    const char *paths[LDO_URING_BATCH];
+    struct ldo_file *lfps[LDO_URING_BATCH];
+    uint64_t start;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        paths[i] = ctx->jobs[ctx->order[base + i]].ent->pathname;
+    }
+
+    start = load_now();
+    ldo_uring_open(paths, lfps, n);
+    ctx->io_ns += load_now() - start;
+
+    for (i = 0; i < n; ++i) {
+        ctx->jobs[ctx->order[base + i]].lfp = lfps[i];
+    }
+
+    ctx->base = base;
+    ldo_parallel_for(n, load_work, ctx);
+}
+
+static struct load_job *sort_jobs;
+
+static int
+load_cmp(const void *a, const void *b)
+{
+    size_t sa = sort_jobs[*(const size_t *)a].ent->size;
+    size_t sb = sort_jobs[*(const size_t *)b].ent->size;
+
+    if (sa != sb)
+        return (sa < sb) ? 1 : -1;
+
+    /* Keep command line order among equals */
+    return (*(const size_t *)a < *(const size_t *)b) ? -1 : 1;
+}
+
+/*
+ * Load every input of a manifest. Inputs are opened
+ * and parsed on the worker pool, largest first so a
+ * big input started late does not hold up the rest,
+ * then added to the link in manifest order. The next
+ * few inputs are always being read ahead so workers
+ * find them in the page cache. If any input fails to
+ * load the first error is returned, whatever did load
+ * is still queued for ldo_fini() to release.
+ *
+ * @mp: Inputs of this link.
+ */
 int
-ldo_init(void)
+ldo_load_all(const struct ldo_manifest *mp)
 {
+    const struct ldo_opts *opts = ldo_rtopts();
+    struct ldo_mfent *sized;
+    struct load_ctx ctx;
+    struct load_job *job;
+    struct stat sb;
+    uint64_t start;
+    size_t i, n = 0, nbad = 0;
+    int err = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.window = opts->readahead;
+
+    ctx.jobs = calloc(mp->count, sizeof(*ctx.jobs));
+    ctx.order = calloc(mp->count, sizeof(*ctx.order));
+    sized = calloc(mp->count, sizeof(*sized));
+    if (ctx.jobs == NULL || ctx.order == NULL || sized == NULL) {
+        free(ctx.jobs);
+        free(ctx.order);
+        free(sized);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < mp->count; ++i) {
+        job = &ctx.jobs[i];
+        sized[i] = mp->ents[i];
+        job->ent = &sized[i];
+
+        /* Parsed by an earlier request? */
+        if ((job->in = ldo_cache_get(sized[i].pathname)) != NULL) {
+            job->warm = 1;
+            continue;
+        }
+
+        /* Sizes only steer scheduling, a failed stat is fine */
+        if (sized[i].size == 0 && stat(sized[i].pathname, &sb) == 0)
+            sized[i].size = sb.st_size;
+
+        ctx.order[n++] = i;
+    }
+
+    sort_jobs = ctx.jobs;
+    qsort(ctx.order, n, sizeof(*ctx.order), load_cmp);
+
+    start = load_now();
+    ctx.n = n;
+    if (ctx.window != 0)
+        load_prefetch(&ctx, ctx.window);
+
+    if ((ldo_rtflags() & LDO_F_NO_URING) == 0 && ldo_uring_init() == 0) {
+        ctx.batched = 1;
+        for (i = 0; i < n; i += LDO_URING_BATCH) {
+            load_batch(&ctx, i, (n - i < LDO_URING_BATCH) ? n - i :
+                LDO_URING_BATCH);
+        }
+    } else {
+        ldo_parallel_for(n, load_work, &ctx);
+    }
+
+    vlog("load: %zu inputs in %.3fs, io %.3fs, cpu %.3fs\n", n,
+        (load_now() - start) / 1e9, ctx.io_ns / 1e9, ctx.cpu_ns / 1e9);
+
+    for (i = 0; i < mp->count; ++i) {
+        job = &ctx.jobs[i];
+        if (job->err < 0) {
+            if (err == 0)
+                err = job->err;
+            ++nbad;
+        }
+
+        /* The hash cache trusts it over mtimes */
+        if (job->in != NULL)
+            job->in->hash = job->ent->hash;
+
+        if (job->in != NULL && job->warm) {
+            TAILQ_INSERT_TAIL(&inputq.q, job->in, link);
+            ++inputq.count;
+        } else if (job->in != NULL) {
+            ldo_add_obj(job->in);
+        } else if (job->ar != NULL) {
+            TAILQ_INSERT_TAIL(&archq.q, job->ar, link);
+            ++archq.count;
+        }
+    }
+
+    if (nbad > 0)
+        fprintf(stderr, "ldo: %zu of %zu inputs failed to load\n", nbad,
+            mp->count);
+
+    free(ctx.jobs);
+    free(ctx.order);
+    free(sized);
+    return err;
+}
+
+/*
+ * Run the link passes over every loaded
+ * input, then release them.
+ */
+int
+ldo_link(void)
+{
+    const struct ldo_opts *opts = ldo_rtopts();
+    ldo_flags_t flags = ldo_rtflags();
+    int icf_mode = LDO_ICF_NONE;
+    int err = 0;
+
+    if ((flags & LDO_F_ICF_ALL) != 0) {
+        icf_mode = LDO_ICF_ALL;
+    } else if ((flags & LDO_F_ICF) != 0) {
+        icf_mode = LDO_ICF_SAFE;
+    }
+
+    err = ldo_archive_resolve(&inputq, &archq);
+    if (err == 0)
+        err = ldo_icf(&inputq, icf_mode);
+    if (err == 0 && opts->order_path != NULL) {
+        if ((err = ldo_order_load(opts->order_path)) == 0)
+            ldo_order_apply(&inputq);
+    }
+    if (err == 0 && opts->out_path != NULL) {
+        if ((err = ldo_sarry_collect(&inputq, &objq)) == 0)
+            err = ldo_output_write(&inputq, &objq, opts->out_path);
+    }
+    if (err == 0 && opts->state_path != NULL) {
+        err = ldo_state_save(opts->state_path, &inputq);
+    }
+
+    ldo_fini();
+    return err;
+}
+
+/*
+ * Release every input of a link, whether or not
+ * it was linked.
+ */
+void
+ldo_fini(void)
+{
+    struct ldo_input *in;
+    struct ldo_archive *ar;
+
+    while (!TAILQ_EMPTY(&inputq.q)) {
+        in = TAILQ_FIRST(&inputq.q);
+        TAILQ_REMOVE(&inputq.q, in, link);
+        if (ldo_cache_put(in) < 0)
+            ldo_input_free(in);
+    }
+
+    /* Members borrow from their archive, free it last */
+    while (!TAILQ_EMPTY(&archq.q)) {
+        ar = TAILQ_FIRST(&archq.q);
+        TAILQ_REMOVE(&archq.q, ar, link);
+        ldo_archive_free(ar);
+    }
+
+    inputq.count = 0;
+    archq.count = 0;
+    sarry_objq_flush(&objq, NULL);
+    ldo_order_free();
+    ldo_state_free();
+}
+
+/*
+ * Get ready for a link.
+ *
+ * @ninputs: Expected number of inputs (0 if unknown).
+ */
+int
+ldo_init(size_t ninputs)
+{
+    const struct ldo_opts *opts = ldo_rtopts();
+    size_t cap = OBJQ_CAP;
+
+    TAILQ_INIT(&inputq.q);
+    TAILQ_INIT(&archq.q);
+    inputq.count = 0;
+    archq.count = 0;
+
+    if (opts->state_path != NULL) {
+        ldo_state_load(opts->state_path);
+    }
+
+    /* One static array object per input at most */
+    if (opts->objq_cap != 0) {
+        cap = opts->objq_cap;
+    } else if (ninputs != 0) {
+        cap = ninputs;
+    }
+
     vlog("Initializing object queue...\n");
-    return sarry_init_objq(&objq, OBJQ_CAP);
+    return sarry_init_objq(&objq, cap);
 }
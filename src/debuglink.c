@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Split debug files. With --split-debug the .debug_*
+ * sections are moved out of the image into a file of
+ * their own, which also carries every allocated section
+ * as SHT_NOBITS so debuggers see the same addresses. The
+ * image gets a .gnu_debuglink naming the file and holding
+ * its CRC32. The debug file is written on its own thread
+ * while the image is copied.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/debuglink.h>
+#include <ldo/input.h>
+#include <ldo/layout.h>
+#include <ldo/compress.h>
+#include <ldo/bswap.h>
+#include <ldo/cdefs.h>
+#include <zlib.h>
+
+#define ALIGNUP(X, A) (((X) + (A) - 1) & ~((uint64_t)(A) - 1))
+
+/*
+ * Returns true if an output section goes to
+ * the debug file.
+ */
+static int
+dbg_wanted(const struct ldo_osec *osp)
+{
+    if ((osp->flags & SHF_ALLOC) != 0)
+        return 0;
+
+    return strncmp(osp->name, ".debug", 6) == 0;
+}
+
+/*
+ * Point every input section of an output at the
+ * output section it is in, after they moved.
+ */
+static void
+dbg_repoint(struct ldo_output *op)
+{
+    struct ldo_osec *osp;
+    size_t i, j, n = 0;
+
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        for (j = 0; j < osp->nisec; ++j) {
+            osp->isecs[j]->osec = osp;
+            if (op->isecs != NULL)
+                op->isecs[n++] = osp->isecs[j];
+        }
+    }
+
+    if (op->isecs != NULL)
+        op->nisec = n;
+}
+
+/*
+ * Move the debug sections of an image into a debug
+ * file and add .gnu_debuglink. Called once sections
+ * are sized but before they are given offsets.
+ *
+ * @op: Output image.
+ * @dp: Debug file to set up.
+ * @pathname: Debug file pathname.
+ */
+int
+ldo_dbg_split(struct ldo_output *op, struct ldo_dbgfile *dp,
+    const char *pathname)
+{
+    struct ldo_output *dop = &dp->out;
+    struct ldo_osec *osp, *link;
+    const char *base;
+    size_t i, j = 0;
+
+    memset(dp, 0, sizeof(*dp));
+    dop->pathname = pathname;
+    dop->fd = -1;
+    dop->osecs = calloc(op->nosec + 1, sizeof(*dop->osecs));
+    if (dop->osecs == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        if (dbg_wanted(osp)) {
+            dop->osecs[dop->nosec++] = *osp;
+            dop->nisec += osp->nisec;
+        } else {
+            op->osecs[j++] = *osp;
+        }
+    }
+
+    op->nosec = j;
+    dop->cap = dop->nosec;
+
+    /* Name padded to 4 bytes, then the CRC */
+    base = strrchr(pathname, '/');
+    base = (base != NULL) ? base + 1 : pathname;
+    dp->link_size = ALIGNUP(strlen(base) + 1, 4) + sizeof(uint32_t);
+    if ((dp->link = calloc(1, dp->link_size)) == NULL)
+        return -ENOMEM;
+    strcpy(dp->link, base);
+
+    link = ldo_osec_new(op, ".gnu_debuglink", SHT_PROGBITS, 0);
+    if (link == NULL)
+        return -ENOMEM;
+    link->data = dp->link;
+    link->size = dp->link_size;
+    link->align = 4;
+
+    dbg_repoint(op);
+    vlog("split-debug: %zu sections to %s\n", dop->nosec, pathname);
+    return 0;
+}
+
+/*
+ * Put a copy of every allocated section of the
+ * image in front of the debug sections and give
+ * them all offsets.
+ */
+static int
+dbg_layout(struct ldo_dbgfile *dp)
+{
+    struct ldo_output *dop = &dp->out;
+    const struct ldo_output *op = dp->image;
+    struct ldo_osec *osecs, *osp, *shstr;
+    size_t i, n = 0, nalloc = 0, size;
+    uint64_t off;
+    char *names;
+
+    for (i = 0; i < op->nosec; ++i) {
+        if ((op->osecs[i].flags & SHF_ALLOC) != 0)
+            ++nalloc;
+    }
+
+    osecs = calloc(nalloc + dop->nosec + 1, sizeof(*osecs));
+    if (osecs == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < op->nosec; ++i) {
+        if ((op->osecs[i].flags & SHF_ALLOC) == 0)
+            continue;
+
+        osp = &osecs[n++];
+        *osp = op->osecs[i];
+        osp->type = SHT_NOBITS;
+        osp->isecs = NULL;
+        osp->nisec = 0;
+        osp->data = NULL;
+        osp->buf = NULL;
+    }
+
+    memcpy(&osecs[n], dop->osecs, dop->nosec * sizeof(*osecs));
+    free(dop->osecs);
+    dop->osecs = osecs;
+    dop->nosec += n;
+    dop->cap = dop->nosec + 1;
+    dbg_repoint(dop);
+
+    shstr = ldo_osec_new(dop, ".shstrtab", SHT_STRTAB, 0);
+    if ((names = ldo_output_shstrtab(dop, &size)) == NULL)
+        return -ENOMEM;
+    shstr->data = names;
+    shstr->buf = names;
+    shstr->size = size;
+
+    off = sizeof(Elf64_Ehdr);
+    for (i = 0; i < dop->nosec; ++i) {
+        osp = &dop->osecs[i];
+        if (osp->type == SHT_NOBITS) {
+            osp->offset = off;
+            continue;
+        }
+
+        osp->offset = ALIGNUP(off, osp->align);
+        osp->addr = 0;
+        off = osp->offset + osp->size;
+    }
+
+    dop->shoff = ALIGNUP(off, 8);
+    dop->size = dop->shoff + (dop->nosec + 1) * sizeof(Elf64_Shdr);
+    return 0;
+}
+
+/*
+ * Write the debug file and take its CRC, runs
+ * on a thread of its own.
+ */
+static void *
+dbg_write(void *arg)
+{
+    struct ldo_dbgfile *dp = arg;
+    struct ldo_output *dop = &dp->out;
+    struct ldo_osec *osp;
+    struct ldo_isec *isp;
+    size_t i, j;
+
+    if ((dp->err = ldo_output_map(dop)) < 0)
+        return NULL;
+
+    for (i = 0; i < dop->nosec; ++i) {
+        osp = &dop->osecs[i];
+        if (osp->type == SHT_NOBITS)
+            continue;
+
+        if (osp->data != NULL) {
+            memcpy(dop->map + osp->offset, osp->data, osp->size);
+            continue;
+        }
+
+        for (j = 0; j < osp->nisec; ++j) {
+            isp = osp->isecs[j];
+            if (isp->data == NULL)
+                continue;
+            if ((dp->err = ldo_isec_copy(isp,
+                dop->map + osp->offset + isp->off)) < 0)
+                return NULL;
+        }
+    }
+
+    ldo_output_headers(dop, dp->first, dop->nosec);
+    dp->crc = crc32(0L, (const Bytef *)dop->map, dop->size);
+    return NULL;
+}
+
+/*
+ * Start writing the debug file, once the image
+ * has been laid out.
+ *
+ * @dp: Debug file from ldo_dbg_split().
+ * @op: Output image.
+ * @first: First input.
+ */
+int
+ldo_dbg_start(struct ldo_dbgfile *dp, const struct ldo_output *op,
+    const struct ldo_input *first)
+{
+    int err;
+
+    dp->image = op;
+    dp->first = first;
+    if ((err = dbg_layout(dp)) < 0)
+        return err;
+
+    if (pthread_create(&dp->td, NULL, dbg_write, dp) != 0) {
+        /* No thread to be had, write it here */
+        dbg_write(dp);
+        return dp->err;
+    }
+
+    dp->running = 1;
+    return 0;
+}
+
+/*
+ * Wait for the debug file and stamp its CRC into
+ * the .gnu_debuglink of the image.
+ *
+ * @dp: Debug file.
+ * @link: .gnu_debuglink contents in the image.
+ */
+int
+ldo_dbg_finish(struct ldo_dbgfile *dp, char *link)
+{
+    uint32_t crc;
+
+    if (dp->running) {
+        pthread_join(dp->td, NULL);
+        dp->running = 0;
+    }
+
+    if (dp->err < 0)
+        return dp->err;
+
+    crc = dp->crc;
+    if (dp->first->data != LDO_HOST_DATA)
+        crc = ldo_bswap32(crc);
+    memcpy(link + dp->link_size - sizeof(crc), &crc, sizeof(crc));
+    vlog("split-debug: %s, %zu bytes, crc 0x%08x\n", dp->out.pathname,
+        dp->out.size, dp->crc);
+    return 0;
+}
+
+/*
+ * Release a debug file, waiting for its thread
+ * if it is still running.
+ *
+ * @dp: Debug file.
+ */
+void
+ldo_dbg_free(struct ldo_dbgfile *dp)
+{
+    if (dp->running) {
+        pthread_join(dp->td, NULL);
+        dp->running = 0;
+    }
+
+    ldo_output_free(&dp->out);
+    free(dp->link);
+}
@@ -27,16 +27,66 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <ldo/file.h>
+#include <ldo/archive.h>
+
+/*
+ * Map an archive instead of reading it. Most of an
+ * archive is members the link never pulls in, those
+ * pages are never touched. The mapping is private so
+ * members in the foreign byte order can still be
+ * swapped in place.
+ */
+static int
+file_map(struct ldo_file *lfp)
+{
+    void *p;
+
+    p = mmap(NULL, lfp->file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+        lfp->fd, 0);
+    if (p == MAP_FAILED)
+        return -errno;
+
+    if ((lfp->data = malloc(sizeof(*lfp->data))) == NULL) {
+        munmap(p, lfp->file_size);
+        return -ENOMEM;
+    }
+
+    lfp->data->data = p;
+    lfp->data->len = lfp->file_size;
+    lfp->mapped = 1;
+    return 0;
+}
+
+/*
+ * Returns true if an open file starts out
+ * like an archive.
+ */
+static int
+file_isarchive(int fd, size_t size)
+{
+    char magic[SARMAG];
+
+    if (size < SARMAG || pread(fd, magic, SARMAG, 0) != SARMAG)
+        return 0;
+
+    return memcmp(magic, ARMAG, SARMAG) == 0 ||
+        memcmp(magic, THINMAG, SARMAG) == 0;
+}
 
 /*
  * Open a file and return an LDO file
- * handle.
+ * handle. Archives are mapped, anything
+ * else is read in.
  *
  * @filename: Path of file.
  * @flags: O_*
@@ -47,16 +97,17 @@ ldo_open(const char *filename, int flags)
     struct stat sb;
     struct ldo_file *lfp = NULL;
     struct ldo_buffer *bp;
-    size_t file_size;
+    size_t done = 0;
+    ssize_t n;
     int retval;
 
-    if (lstat(filename, &sb) < 0) {
+    if (stat(filename, &sb) < 0) {
         fprintf(stderr, "failed to stat '%s'\n", filename);
-        perror("lstat");
+        perror("stat");
         return NULL;
     }
 
-    if ((lfp = malloc(sizeof(*lfp))) == NULL) {
+    if ((lfp = calloc(1, sizeof(*lfp))) == NULL) {
         fprintf(stderr, "lfp malloc failure (open %s)\n", filename);
         return NULL;
     }
@@ -70,6 +121,20 @@ ldo_open(const char *filename, int flags)
 
     lfp->fd = retval;
     lfp->file_size = sb.st_size;
+    lfp->mtime = sb.st_mtim;
+
+    if (file_isarchive(lfp->fd, lfp->file_size)) {
+        if (file_map(lfp) < 0) {
+            fprintf(stderr, "failed to map %s\n", filename);
+            close(lfp->fd);
+            free(lfp);
+            return NULL;
+        }
+        close(lfp->fd);
+        lfp->fd = -1;
+        return lfp;
+    }
+
     lfp->data = ldo_allocz(lfp->file_size);
 
     if (lfp->data == NULL) {
@@ -79,15 +144,91 @@ ldo_open(const char *filename, int flags)
 
     }
 
+    /* read() stops short of 2 GiB, big inputs take several */
     bp = lfp->data;
-    read(lfp->fd, bp->data, lfp->file_size);
+    while (done < lfp->file_size) {
+        n = read(lfp->fd, bp->data + done, lfp->file_size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            fprintf(stderr, "short read on %s\n", filename);
+            ldo_close(lfp);
+            return NULL;
+        }
+        done += n;
+    }
+
+    /* Everything is in memory, don't hold a descriptor per input */
+    close(lfp->fd);
+    lfp->fd = -1;
+    return lfp;
+}
+
+/*
+ * Make a file handle for `len' bytes at `off' of
+ * another file. The data is borrowed rather than
+ * copied unless it is not aligned well enough for
+ * ELF structures, archive members only start on an
+ * even offset. Either way it is the only copy, as
+ * archives are mapped. `parent' must outlive the
+ * view.
+ *
+ * @parent: File to borrow from.
+ * @off: Offset into `parent'.
+ * @len: Length of the view.
+ */
+struct ldo_file *
+ldo_view(struct ldo_file *parent, size_t off, size_t len)
+{
+    struct ldo_file *lfp;
+    const char *p;
+
+    if (off > parent->file_size || len > parent->file_size - off)
+        return NULL;
+    if ((lfp = calloc(1, sizeof(*lfp))) == NULL)
+        return NULL;
+
+    lfp->fd = -1;
+    lfp->file_size = len;
+    lfp->mtime = parent->mtime;
+    p = LDO_BUFSTREAM(parent->data) + off;
+
+    /* Misaligned, take a copy */
+    if (((uintptr_t)p & 7) != 0) {
+        if ((lfp->data = ldo_allocz(len)) == NULL) {
+            free(lfp);
+            return NULL;
+        }
+        memcpy(lfp->data->data, p, len);
+        return lfp;
+    }
+
+    if ((lfp->data = malloc(sizeof(*lfp->data))) == NULL) {
+        free(lfp);
+        return NULL;
+    }
+
+    lfp->data->data = (char *)p;
+    lfp->data->len = len;
+    lfp->parent = parent;
     return lfp;
 }
 
 void
 ldo_close(struct ldo_file *lfp)
 {
-    close(lfp->fd);
-    ldo_free(lfp->data);
+    if (lfp->fd >= 0)
+        close(lfp->fd);
+
+    /* Views only own the buffer descriptor */
+    if (lfp->mapped) {
+        munmap(lfp->data->data, lfp->file_size);
+        free(lfp->data);
+    } else if (lfp->parent != NULL) {
+        free(lfp->data);
+    } else {
+        ldo_free(lfp->data);
+    }
+
     free(lfp);
 }
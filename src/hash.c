@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <ldo/hash.h>
+#include <ldo/input.h>
+#include <ldo/bswap.h>
+
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+#define ROTL(X, N) (((X) << (N)) | ((X) >> (64 - (N))))
+
+/*
+ * Words are read little-endian on every host, so
+ * a hash of the same bytes never depends on where
+ * it was computed.
+ */
+static inline uint64_t
+rd64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    if (LDO_HOST_DATA != ELFDATA2LSB)
+        v = ldo_bswap64(v);
+    return v;
+}
+
+static inline uint64_t
+round64(uint64_t acc, uint64_t in)
+{
+    acc += in * LDO_HASH_P2;
+    acc = ROTL(acc, 31);
+    return acc * LDO_HASH_P1;
+}
+
+/*
+ * Hash a buffer 32 bytes at a time using four
+ * independent lanes so the multiplies can overlap,
+ * then fold in the tail a word at a time.
+ *
+ * @buf: Buffer to hash.
+ * @len: Length of buffer.
+ * @seed: Seed value, different seeds give unrelated hashes.
+ */
+uint64_t
+ldo_hash64(const void *buf, size_t len, uint64_t seed)
+{
+    const unsigned char *p = buf;
+    const unsigned char *end = p + len;
+    uint64_t v1, v2, v3, v4;
+    uint64_t h;
+
+    if (len >= 32) {
+        v1 = seed + LDO_HASH_P1 + LDO_HASH_P2;
+        v2 = seed + LDO_HASH_P2;
+        v3 = seed;
+        v4 = seed - LDO_HASH_P1;
+
+        while ((size_t)(end - p) >= 32) {
+            v1 = round64(v1, rd64(p));
+            v2 = round64(v2, rd64(p + 8));
+            v3 = round64(v3, rd64(p + 16));
+            v4 = round64(v4, rd64(p + 24));
+            p += 32;
+        }
+
+        h = ROTL(v1, 1) + ROTL(v2, 7) + ROTL(v3, 12) + ROTL(v4, 18);
+        h = (h ^ round64(0, v1)) * LDO_HASH_P1 + P4;
+        h = (h ^ round64(0, v2)) * LDO_HASH_P1 + P4;
+        h = (h ^ round64(0, v3)) * LDO_HASH_P1 + P4;
+        h = (h ^ round64(0, v4)) * LDO_HASH_P1 + P4;
+    } else {
+        h = seed + P5;
+    }
+
+    h += (uint64_t)len;
+    while ((size_t)(end - p) >= 8) {
+        h ^= round64(0, rd64(p));
+        h = ROTL(h, 27) * LDO_HASH_P1 + P4;
+        p += 8;
+    }
+
+    while (p < end) {
+        h ^= (*p++) * P5;
+        h = ROTL(h, 11) * LDO_HASH_P1;
+    }
+
+    /* Final avalanche */
+    h ^= h >> 33;
+    h *= LDO_HASH_P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
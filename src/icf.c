@@ -0,0 +1,654 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Identical code folding: read-only sections with equal
+ * contents whose relocations point at equivalent targets
+ * are folded into a single copy. Each candidate starts
+ * out with a class hash of everything it owns, then every
+ * round mixes in the classes of the candidates it refers
+ * to until the number of distinct classes stops growing.
+ * Rounds only depend on the previous round so each one
+ * runs in parallel across all candidates.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/icf.h>
+#include <ldo/hash.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+
+/* Relocation target kinds */
+#define TGT_ABS     0x0000      /* Absolute value */
+#define TGT_SEC     0x0001      /* Section that is not a candidate */
+#define TGT_CAND    0x0002      /* Candidate, compared by class */
+#define TGT_NAME    0x0003      /* Resolved by symbol name */
+
+/*
+ * Relocation target as far as ICF cares.
+ *
+ * @kind: TGT_* kind.
+ * @id: Section pointer or candidate index.
+ * @name: Symbol name for TGT_NAME.
+ * @value: Offset into the target.
+ */
+struct icf_tgt {
+    int kind;
+    uint64_t id;
+    const char *name;
+    uint64_t value;
+};
+
+/*
+ * Candidate class and index, sorted to
+ * find classes.
+ */
+struct icf_ent {
+    uint64_t cls;
+    uint32_t idx;
+};
+
+/*
+ * State shared by the ICF workers.
+ *
+ * @inputs: Every input object.
+ * @ninput: Number of inputs.
+ * @cand: Sections that may be folded.
+ * @ncand: Number of candidates.
+ * @cls: Current class of each candidate.
+ * @next: Class being computed this round.
+ * @ents: Scratch space for counting classes.
+ * @taken: Names with their address taken (open addressing).
+ * @ntaken: Number of slots in `taken'.
+ */
+struct icf_state {
+    struct ldo_input **inputs;
+    size_t ninput;
+    struct ldo_isec **cand;
+    size_t ncand;
+    uint64_t *cls;
+    uint64_t *next;
+    struct icf_ent *ents;
+    const char **taken;
+    size_t ntaken;
+};
+
+/*
+ * Sections that are never folded as their
+ * position matters, or that are packed
+ * elsewhere by name.
+ */
+static const char *icf_skip[] = {
+    ".init", ".fini", ".ctors", ".dtors", ".eh_frame", ".static_array",
+    NULL
+};
+
+static inline uint64_t
+icf_strhash(const char *s)
+{
+    return ldo_hash64(s, strlen(s), 0);
+}
+
+/*
+ * Returns true if a relocation type can only be
+ * used to branch to its target, meaning the target
+ * address never escapes.
+ */
+static inline int
+icf_isbranch(Elf64_Half mach, uint32_t type)
+{
+    switch (mach) {
+    case EM_X86_64:
+        return type == R_X86_64_PLT32;
+    case EM_AARCH64:
+        return type == R_AARCH64_CALL26 || type == R_AARCH64_JUMP26;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns true if relocations from this section
+ * count towards taking an address.
+ */
+static inline int
+icf_isref(const struct ldo_isec *isp)
+{
+    if ((isp->shdr->sh_flags & SHF_ALLOC) == 0)
+        return 0;
+
+    return strcmp(isp->name, ".eh_frame") != 0;
+}
+
+static int
+icf_eligible(const struct ldo_isec *isp, int mode)
+{
+    const Elf64_Shdr *shdr = isp->shdr;
+    const Elf64_Xword noflags = SHF_WRITE | SHF_TLS | SHF_MERGE |
+        SHF_LINK_ORDER | SHF_COMPRESSED;
+    size_t i;
+
+    if (shdr->sh_type != SHT_PROGBITS || isp->size == 0)
+        return 0;
+    if ((shdr->sh_flags & SHF_ALLOC) == 0)
+        return 0;
+    if ((shdr->sh_flags & noflags) != 0)
+        return 0;
+    if (mode == LDO_ICF_SAFE && (isp->flags & LDO_ISEC_ADDRTAKEN) != 0)
+        return 0;
+
+    for (i = 0; icf_skip[i] != NULL; ++i) {
+        if (strncmp(isp->name, icf_skip[i], strlen(icf_skip[i])) == 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Describe the target of a relocation. Weak
+ * definitions may be overridden elsewhere so
+ * they are compared by name.
+ */
+static void
+icf_target(const struct ldo_isec *isp, const Elf64_Rela *r,
+    struct icf_tgt *tp)
+{
+    struct ldo_input *in = isp->in;
+    struct ldo_isec *tsec;
+    const Elf64_Sym *sym;
+    size_t symidx;
+
+    symidx = ELF64_R_SYM(r->r_info);
+    tp->kind = TGT_ABS;
+    tp->id = 0;
+    tp->name = NULL;
+    tp->value = r->r_addend;
+
+    if (symidx == 0 || symidx >= in->nsym)
+        return;
+
+    sym = &in->syms[symidx];
+    tsec = ldo_input_symsec(in, symidx);
+    if (tsec != NULL && ELF64_ST_BIND(sym->st_info) != STB_WEAK) {
+        tp->value += sym->st_value;
+        if (tsec->icf_idx != LDO_NOIDX) {
+            tp->kind = TGT_CAND;
+            tp->id = tsec->icf_idx;
+        } else {
+            tp->kind = TGT_SEC;
+            tp->id = (uintptr_t)tsec;
+        }
+        return;
+    }
+
+    if (sym->st_shndx == SHN_ABS) {
+        tp->value += sym->st_value;
+        return;
+    }
+
+    tp->kind = TGT_NAME;
+    tp->name = ldo_input_symname(in, symidx);
+}
+
+/*
+ * Look up a name in the address-taken set, returns
+ * the slot it lives in or the empty slot it would
+ * go in.
+ */
+static const char **
+icf_taken_slot(struct icf_state *sp, const char *name)
+{
+    size_t mask = sp->ntaken - 1;
+    size_t i;
+
+    i = icf_strhash(name) & mask;
+    while (sp->taken[i] != NULL) {
+        if (strcmp(sp->taken[i], name) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &sp->taken[i];
+}
+
+/*
+ * Mark sections whose address is taken by a relocation
+ * within the same object. Sections are only ever marked
+ * by relocations of their own input, so inputs can be
+ * processed in parallel.
+ */
+static void
+icf_mark_work(size_t idx, void *arg)
+{
+    struct icf_state *sp = arg;
+    struct ldo_input *in = sp->inputs[idx];
+    struct ldo_isec *isp, *tsec;
+    const Elf64_Rela *r;
+    size_t i, j;
+
+    for (i = 0; i < in->nsec; ++i) {
+        isp = &in->isecs[i];
+        if (isp->nrela == 0 || !icf_isref(isp))
+            continue;
+
+        for (j = 0; j < isp->nrela; ++j) {
+            r = &isp->rela[j];
+            if (icf_isbranch(in->eh->e_machine, ELF64_R_TYPE(r->r_info)))
+                continue;
+            tsec = ldo_input_symsec(in, ELF64_R_SYM(r->r_info));
+            if (tsec != NULL)
+                tsec->flags |= LDO_ISEC_ADDRTAKEN;
+        }
+    }
+}
+
+/*
+ * Mark sections defining a global symbol that some
+ * other object takes the address of by name.
+ */
+static void
+icf_mark_global_work(size_t idx, void *arg)
+{
+    struct icf_state *sp = arg;
+    struct ldo_input *in = sp->inputs[idx];
+    struct ldo_isec *tsec;
+    const char **slot;
+    size_t i;
+
+    for (i = 1; i < in->nsym; ++i) {
+        if (ELF64_ST_BIND(in->syms[i].st_info) == STB_LOCAL)
+            continue;
+        if ((tsec = ldo_input_symsec(in, i)) == NULL)
+            continue;
+
+        slot = icf_taken_slot(sp, ldo_input_symname(in, i));
+        if (*slot != NULL)
+            tsec->flags |= LDO_ISEC_ADDRTAKEN;
+    }
+}
+
+/*
+ * Find every section whose address escapes, this
+ * is what makes the "safe" mode safe.
+ */
+static int
+icf_mark(struct icf_state *sp)
+{
+    struct ldo_input *in;
+    struct ldo_isec *isp;
+    const Elf64_Rela *r;
+    const char **slot;
+    size_t nref = 0;
+    size_t i, j, k;
+
+    ldo_parallel_for(sp->ninput, icf_mark_work, sp);
+
+    /* Size the name set for every undefined reference */
+    for (i = 0; i < sp->ninput; ++i) {
+        in = sp->inputs[i];
+        for (j = 0; j < in->nsec; ++j) {
+            nref += in->isecs[j].nrela;
+        }
+    }
+
+    sp->ntaken = 16;
+    while (sp->ntaken < nref * 2)
+        sp->ntaken <<= 1;
+
+    sp->taken = calloc(sp->ntaken, sizeof(*sp->taken));
+    if (sp->taken == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < sp->ninput; ++i) {
+        in = sp->inputs[i];
+        for (j = 0; j < in->nsec; ++j) {
+            isp = &in->isecs[j];
+            if (isp->nrela == 0 || !icf_isref(isp))
+                continue;
+
+            for (k = 0; k < isp->nrela; ++k) {
+                r = &isp->rela[k];
+                if (icf_isbranch(in->eh->e_machine, ELF64_R_TYPE(r->r_info)))
+                    continue;
+                if (ldo_input_symsec(in, ELF64_R_SYM(r->r_info)) != NULL)
+                    continue;
+                if (ELF64_R_SYM(r->r_info) == 0)
+                    continue;
+
+                slot = icf_taken_slot(sp, ldo_input_symname(in,
+                    ELF64_R_SYM(r->r_info)));
+                if (*slot == NULL)
+                    *slot = ldo_input_symname(in, ELF64_R_SYM(r->r_info));
+            }
+        }
+    }
+
+    ldo_parallel_for(sp->ninput, icf_mark_global_work, sp);
+    return 0;
+}
+
+/*
+ * Compute the initial class of a candidate from
+ * everything but the classes of other candidates.
+ */
+static void
+icf_hash_work(size_t idx, void *arg)
+{
+    struct icf_state *sp = arg;
+    struct ldo_isec *isp = sp->cand[idx];
+    const Elf64_Shdr *shdr = isp->shdr;
+    const Elf64_Rela *r;
+    struct icf_tgt t;
+    uint64_t h;
+    size_t i;
+
+    h = ldo_hash_mix(ldo_isec_hash(isp), shdr->sh_flags);
+    h = ldo_hash_mix(h, shdr->sh_entsize);
+    h = ldo_hash_mix(h, shdr->sh_addralign);
+    h = ldo_hash_mix(h, isp->size);
+    h = ldo_hash_mix(h, isp->nrela);
+
+    for (i = 0; i < isp->nrela; ++i) {
+        r = &isp->rela[i];
+        icf_target(isp, r, &t);
+
+        h = ldo_hash_mix(h, r->r_offset);
+        h = ldo_hash_mix(h, ELF64_R_TYPE(r->r_info));
+        h = ldo_hash_mix(h, t.kind);
+        h = ldo_hash_mix(h, t.value);
+
+        switch (t.kind) {
+        case TGT_SEC:
+            h = ldo_hash_mix(h, t.id);
+            break;
+        case TGT_NAME:
+            h = ldo_hash_mix(h, icf_strhash(t.name));
+            break;
+        }
+    }
+
+    sp->cls[idx] = h;
+}
+
+/*
+ * Refine the class of a candidate with the classes
+ * its relocations point at.
+ */
+static void
+icf_round_work(size_t idx, void *arg)
+{
+    struct icf_state *sp = arg;
+    struct ldo_isec *isp = sp->cand[idx];
+    struct icf_tgt t;
+    uint64_t h;
+    size_t i;
+
+    h = sp->cls[idx];
+    for (i = 0; i < isp->nrela; ++i) {
+        icf_target(isp, &isp->rela[i], &t);
+        if (t.kind == TGT_CAND)
+            h = ldo_hash_mix(h, sp->cls[t.id]);
+    }
+
+    sp->next[idx] = h;
+}
+
+static int
+icf_entcmp(const void *a, const void *b)
+{
+    const struct icf_ent *ea = a, *eb = b;
+
+    if (ea->cls != eb->cls)
+        return (ea->cls < eb->cls) ? -1 : 1;
+    if (ea->idx != eb->idx)
+        return (ea->idx < eb->idx) ? -1 : 1;
+
+    return 0;
+}
+
+/*
+ * Sort candidates by class and return the
+ * number of distinct classes.
+ */
+static size_t
+icf_classes(struct icf_state *sp)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < sp->ncand; ++i) {
+        sp->ents[i].cls = sp->cls[i];
+        sp->ents[i].idx = i;
+    }
+
+    qsort(sp->ents, sp->ncand, sizeof(*sp->ents), icf_entcmp);
+    for (i = 0; i < sp->ncand; ++i) {
+        if (i == 0 || sp->ents[i].cls != sp->ents[i - 1].cls)
+            ++n;
+    }
+
+    return n;
+}
+
+/*
+ * Exact comparison of two candidates in the same
+ * class, hashes only get us this far.
+ */
+static int
+icf_equal(struct icf_state *sp, uint32_t ai, uint32_t bi)
+{
+    const struct ldo_isec *a = sp->cand[ai];
+    const struct ldo_isec *b = sp->cand[bi];
+    const Elf64_Rela *ra, *rb;
+    struct icf_tgt ta, tb;
+    size_t i;
+
+    if (a->size != b->size || a->nrela != b->nrela)
+        return 0;
+    if (a->shdr->sh_flags != b->shdr->sh_flags)
+        return 0;
+    if (a->shdr->sh_entsize != b->shdr->sh_entsize)
+        return 0;
+    if (a->shdr->sh_addralign != b->shdr->sh_addralign)
+        return 0;
+    if (memcmp(a->data, b->data, a->size) != 0)
+        return 0;
+
+    for (i = 0; i < a->nrela; ++i) {
+        ra = &a->rela[i];
+        rb = &b->rela[i];
+        if (ra->r_offset != rb->r_offset)
+            return 0;
+        if (ELF64_R_TYPE(ra->r_info) != ELF64_R_TYPE(rb->r_info))
+            return 0;
+
+        icf_target(a, ra, &ta);
+        icf_target(b, rb, &tb);
+        if (ta.kind != tb.kind || ta.value != tb.value)
+            return 0;
+
+        switch (ta.kind) {
+        case TGT_SEC:
+            if (ta.id != tb.id)
+                return 0;
+            break;
+        case TGT_CAND:
+            if (sp->cls[ta.id] != sp->cls[tb.id])
+                return 0;
+            break;
+        case TGT_NAME:
+            if (strcmp(ta.name, tb.name) != 0)
+                return 0;
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Fold every class member into the first
+ * member of its class.
+ */
+static void
+icf_fold(struct icf_state *sp, size_t *nfoldp, size_t *savedp)
+{
+    struct ldo_isec *leader, *isp;
+    size_t start, i;
+
+    for (start = 0; start < sp->ncand; start = i) {
+        leader = sp->cand[sp->ents[start].idx];
+        for (i = start + 1; i < sp->ncand; ++i) {
+            if (sp->ents[i].cls != sp->ents[start].cls)
+                break;
+            if (!icf_equal(sp, sp->ents[start].idx, sp->ents[i].idx))
+                continue;
+
+            isp = sp->cand[sp->ents[i].idx];
+            isp->repl = leader;
+            isp->flags |= LDO_ISEC_FOLDED;
+            ++(*nfoldp);
+            *savedp += isp->size;
+        }
+    }
+}
+
+static void
+icf_free(struct icf_state *sp)
+{
+    size_t i;
+
+    for (i = 0; i < sp->ncand; ++i) {
+        sp->cand[i]->icf_idx = LDO_NOIDX;
+    }
+
+    free(sp->inputs);
+    free(sp->cand);
+    free(sp->cls);
+    free(sp->next);
+    free(sp->ents);
+    free(sp->taken);
+}
+
+/*
+ * Run identical code folding over every
+ * loaded input.
+ *
+ * @iq: Input queue.
+ * @mode: LDO_ICF_* mode.
+ */
+int
+ldo_icf(struct ldo_inputq *iq, int mode)
+{
+    struct icf_state st;
+    struct ldo_input *in;
+    struct ldo_isec *isp;
+    uint64_t *tmp;
+    size_t nclass, n, nround = 0;
+    size_t nfold = 0, saved = 0;
+    size_t i;
+    int err = 0;
+
+    if (mode == LDO_ICF_NONE || iq->count == 0)
+        return 0;
+
+    memset(&st, 0, sizeof(st));
+    st.inputs = calloc(iq->count, sizeof(*st.inputs));
+    if (st.inputs == NULL)
+        return -ENOMEM;
+
+    TAILQ_FOREACH(in, &iq->q, link) {
+        st.inputs[st.ninput++] = in;
+    }
+
+    if (mode == LDO_ICF_SAFE && (err = icf_mark(&st)) < 0)
+        goto done;
+
+    /* Gather up the candidates */
+    for (i = 0; i < st.ninput; ++i) {
+        in = st.inputs[i];
+        for (n = 0; n < in->nsec; ++n) {
+            if (icf_eligible(&in->isecs[n], mode))
+                ++st.ncand;
+        }
+    }
+
+    st.cand = calloc(st.ncand + 1, sizeof(*st.cand));
+    st.cls = calloc(st.ncand + 1, sizeof(*st.cls));
+    st.next = calloc(st.ncand + 1, sizeof(*st.next));
+    st.ents = calloc(st.ncand + 1, sizeof(*st.ents));
+    if (st.cand == NULL || st.cls == NULL || st.next == NULL ||
+        st.ents == NULL) {
+        err = -ENOMEM;
+        st.ncand = 0;
+        goto done;
+    }
+
+    st.ncand = 0;
+    for (i = 0; i < st.ninput; ++i) {
+        in = st.inputs[i];
+        for (n = 0; n < in->nsec; ++n) {
+            isp = &in->isecs[n];
+            if (!icf_eligible(isp, mode))
+                continue;
+            isp->icf_idx = st.ncand;
+            st.cand[st.ncand++] = isp;
+        }
+    }
+
+    ldo_parallel_for(st.ncand, icf_hash_work, &st);
+    nclass = icf_classes(&st);
+
+    /* Refine until we hit a fixed point */
+    for (;;) {
+        ++nround;
+        ldo_parallel_for(st.ncand, icf_round_work, &st);
+        tmp = st.cls;
+        st.cls = st.next;
+        st.next = tmp;
+
+        if ((n = icf_classes(&st)) == nclass)
+            break;
+        nclass = n;
+    }
+
+    icf_fold(&st, &nfold, &saved);
+    vlog("icf: %zu candidates, %zu rounds, folded %zu sections (%zu bytes)\n",
+        st.ncand, nround, nfold, saved);
+done:
+    if (err < 0)
+        fprintf(stderr, "ldo_icf: failed (retval=%d)\n", err);
+    icf_free(&st);
+    return err;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_ARCHIVE_H_
+#define LDO_ARCHIVE_H_
+
+#include <sys/queue.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/file.h>
+#include <ldo/input.h>
+
+#define ARMAG       "!<arch>\n"     /* Regular archive */
+#define THINMAG     "!<thin>\n"     /* Thin archive */
+#define SARMAG      8
+
+#define ARFMAG      "`\n"           /* Member header trailer */
+
+/*
+ * Archive member header, every field is
+ * space padded ASCII.
+ */
+struct ar_hdr {
+    char ar_name[16];
+    char ar_date[12];
+    char ar_uid[6];
+    char ar_gid[6];
+    char ar_mode[8];
+    char ar_size[10];
+    char ar_fmag[2];
+};
+
+/*
+ * Represents a static archive. Members are only
+ * loaded when they define a symbol some loaded
+ * object still needs.
+ *
+ * @pathname: Archive pathname.
+ * @lfp: Archive file.
+ * @thin: Set for thin archives, members live in
+ *        their own files.
+ * @nsyms: Number of symbol index entries.
+ * @offs: Symbol index member offsets (big endian).
+ * @offsz: Size of an entry of `offs' (4 or 8).
+ * @names: Symbol index names.
+ * @lnames: Long member name table.
+ * @lnsize: Size of `lnames'.
+ * @loaded: Offsets of loaded members (open addressing).
+ * @nloaded: Number of slots in `loaded'.
+ * @strs: Pathnames built for loaded members.
+ * @nstrs: Number of pathnames.
+ * @link: Queue link.
+ */
+struct ldo_archive {
+    const char *pathname;
+    struct ldo_file *lfp;
+    int thin;
+    size_t nsyms;
+    const unsigned char *offs;
+    size_t offsz;
+    const char **names;
+    const char *lnames;
+    size_t lnsize;
+    uint64_t *loaded;
+    size_t nloaded;
+    char **strs;
+    size_t nstrs;
+    TAILQ_ENTRY(ldo_archive) link;
+};
+
+/*
+ * Queue of archives in command line order.
+ *
+ * @q: TAILQ head.
+ * @count: Number of archives.
+ */
+struct ldo_archiveq {
+    TAILQ_HEAD(, ldo_archive) q;
+    size_t count;
+};
+
+int ldo_isarchive(const struct ldo_file *lfp);
+struct ldo_archive *ldo_archive_new(const char *pathname, struct ldo_file *lfp);
+void ldo_archive_free(struct ldo_archive *ar);
+int ldo_archive_resolve(struct ldo_inputq *iq, struct ldo_archiveq *aq);
+
+#endif  /* !LDO_ARCHIVE_H_ */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_BSWAP_H_
+#define LDO_BSWAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/elf.h>
+
+/*
+ * Byte swapping for objects in the foreign byte order.
+ * Their headers and tables are swapped once, in place,
+ * when they are loaded, and every later phase reads
+ * them natively. Objects in the host byte order never
+ * go near these.
+ */
+
+#define ldo_bswap16(X) __builtin_bswap16(X)
+#define ldo_bswap32(X) __builtin_bswap32(X)
+#define ldo_bswap64(X) __builtin_bswap64(X)
+
+void ldo_bswap_words(uint64_t *p, size_t n);
+void ldo_bswap_ehdr(Elf64_Ehdr *eh);
+void ldo_bswap_shdrs(Elf64_Shdr *shdrs, size_t n);
+void ldo_bswap_phdrs(Elf64_Phdr *phdrs, size_t n);
+void ldo_bswap_syms(Elf64_Sym *syms, size_t n);
+void ldo_bswap_relas(Elf64_Rela *relas, size_t n);
+void ldo_bswap_nhdr(Elf64_Nhdr *nhdr);
+
+#endif  /* !LDO_BSWAP_H_ */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_DEBUGLINK_H_
+#define LDO_DEBUGLINK_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/output.h>
+
+/*
+ * Separate debug file, written on its own thread
+ * while the image is being written.
+ *
+ * @out: The debug file.
+ * @image: The image it goes with.
+ * @first: First input, for the ELF header.
+ * @link: Contents of .gnu_debuglink in the image.
+ * @link_size: Size of `link'.
+ * @crc: CRC32 of the finished debug file.
+ * @td: Writer thread.
+ * @running: Set until `td' is joined.
+ * @err: Result of the writer thread.
+ */
+struct ldo_dbgfile {
+    struct ldo_output out;
+    const struct ldo_output *image;
+    const struct ldo_input *first;
+    char *link;
+    size_t link_size;
+    uint32_t crc;
+    pthread_t td;
+    int running;
+    int err;
+};
+
+int ldo_dbg_split(struct ldo_output *op, struct ldo_dbgfile *dp,
+    const char *pathname);
+int ldo_dbg_start(struct ldo_dbgfile *dp, const struct ldo_output *op,
+    const struct ldo_input *first);
+int ldo_dbg_finish(struct ldo_dbgfile *dp, char *link);
+void ldo_dbg_free(struct ldo_dbgfile *dp);
+
+#endif  /* !LDO_DEBUGLINK_H_ */
@@ -32,14 +32,27 @@
 
 #include <ldo/buffer.h>
 #include <fcntl.h>
+#include <time.h>
 
+/*
+ * @fd: File descriptor (-1 once the contents are read).
+ * @file_size: Size of the file data.
+ * @mtime: Modification time.
+ * @data: File contents.
+ * @parent: File `data' is borrowed from (or NULL).
+ * @mapped: `data' is a private mapping of the file.
+ */
 struct ldo_file {
     int fd;
     size_t file_size;
+    struct timespec mtime;
     struct ldo_buffer *data;
+    struct ldo_file *parent;
+    int mapped;
 };
 
 struct ldo_file *ldo_open(const char *filename, int flags);
+struct ldo_file *ldo_view(struct ldo_file *parent, size_t off, size_t len);
 void ldo_close(struct ldo_file *lfp);
 
 #endif  /* !LDO_FILE_H_ */
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_INPUT_H_
+#define LDO_INPUT_H_
+
+#include <sys/queue.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/file.h>
+#include <ldo/elf.h>
+#include <ldo/ldo.h>
+
+/* Input section flags */
+#define LDO_ISEC_ADDRTAKEN  (1 << 0)    /* Address used by non-branch */
+#define LDO_ISEC_FOLDED     (1 << 1)    /* Folded into `repl' by ICF */
+#define LDO_ISEC_SARRY      (1 << 2)    /* Packed into .static_array */
+#define LDO_ISEC_DEAD       (1 << 3)    /* Stripped, never looked at */
+#define LDO_ISEC_POOL       (1 << 4)    /* Made up by string merging */
+
+/* Byte order of the host as an ELFDATA* value */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LDO_HOST_DATA       ELFDATA2MSB
+#else
+#define LDO_HOST_DATA       ELFDATA2LSB
+#endif  /* __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ */
+
+/* Input object flags */
+#define LDO_IN_CACHED       (1 << 0)    /* Unchanged since last link */
+
+/* Largest section alignment accepted */
+#define LDO_MAX_ALIGN       (1ULL << 30)
+
+/* Largest SHT_NOBITS section accepted */
+#define LDO_MAX_NOBITS      (1ULL << 40)
+
+/* Best ratio deflate can reach, bounds SHF_COMPRESSED sizes */
+#define LDO_MAX_INFLATE     1032
+
+/* No index assigned */
+#define LDO_NOIDX UINT32_MAX
+
+struct ldo_input;
+struct ldo_osec;
+struct ldo_mergein;
+struct sarry_pack;
+
+/*
+ * Represents a single section of an input
+ * object. Contents are never copied, `data'
+ * points into the input file buffer. For an
+ * SHF_COMPRESSED section it points past the
+ * Elf64_Chdr and is only inflated when it is
+ * copied out (see ldo_isec_copy()).
+ *
+ * @in: Input object this section belongs to.
+ * @shdr: Section header.
+ * @name: Section name.
+ * @data: Section contents (NULL for SHT_NOBITS).
+ * @size: Size of section in bytes (uncompressed).
+ * @zsize: Size of compressed `data' (0 if stored raw).
+ * @align: Alignment of the (uncompressed) contents.
+ * @index: Section header index within `in'.
+ * @flags: LDO_ISEC_* flags.
+ * @rela: Relocations applying to this section.
+ * @nrela: Number of relocations.
+ * @repl: Section to use in place of this one.
+ * @icf_idx: ICF candidate index (or LDO_NOIDX).
+ * @hash: Content hash, zero until computed.
+ * @order: Position requested by a profile (or LDO_NOIDX).
+ * @osec: Output section this section goes in.
+ * @off: Offset within `osec'.
+ * @merge: String pool it was merged into (or NULL).
+ * @pack: Compressed static array, kept across links (or NULL).
+ */
+struct ldo_isec {
+    struct ldo_input *in;
+    const Elf64_Shdr *shdr;
+    const char *name;
+    const char *data;
+    size_t size;
+    size_t zsize;
+    uint64_t align;
+    uint32_t index;
+    uint32_t flags;
+    const Elf64_Rela *rela;
+    size_t nrela;
+    struct ldo_isec *repl;
+    uint32_t icf_idx;
+    uint64_t hash;
+    uint32_t order;
+    struct ldo_osec *osec;
+    uint64_t off;
+    struct ldo_mergein *merge;
+    struct sarry_pack *pack;
+};
+
+/*
+ * An ELF object whose header and section header
+ * table have been validated, later phases use it
+ * without checking again. Both are in the host byte
+ * order by then, whatever `data' says.
+ *
+ * @eh: ELF header.
+ * @shdrs: Section header table (NULL if none).
+ * @nsec: Number of section headers.
+ * @shstrndx: Index of the section name table.
+ * @mach: LDO_* machine type.
+ * @data: ELFDATA2LSB or ELFDATA2MSB.
+ */
+struct ldo_elfdesc {
+    const Elf64_Ehdr *eh;
+    const Elf64_Shdr *shdrs;
+    size_t nsec;
+    size_t shstrndx;
+    ldo_mach_t mach;
+    uint8_t data;
+};
+
+/*
+ * Represents an ELF input object that has been
+ * loaded and indexed.
+ *
+ * @pathname: Object file pathname.
+ * @lfp: Backing file.
+ * @eh: ELF header.
+ * @mach: LDO_* machine type.
+ * @data: Byte order of the object (ELFDATA*).
+ * @shdrs: Section header table.
+ * @isecs: Input sections, indexed like `shdrs'.
+ * @nsec: Number of sections.
+ * @shstrndx: Index of the section name table.
+ * @syms: Symbol table.
+ * @nsym: Number of symbols.
+ * @strtab: Symbol string table.
+ * @strsz: Size of `strtab'.
+ * @flags: LDO_IN_* flags.
+ * @hash: Content hash given by the manifest (0 if unknown).
+ * @link: Queue link.
+ */
+struct ldo_input {
+    const char *pathname;
+    struct ldo_file *lfp;
+    const Elf64_Ehdr *eh;
+    ldo_mach_t mach;
+    uint8_t data;
+    const Elf64_Shdr *shdrs;
+    struct ldo_isec *isecs;
+    size_t nsec;
+    size_t shstrndx;
+    const Elf64_Sym *syms;
+    size_t nsym;
+    const char *strtab;
+    size_t strsz;
+    uint32_t flags;
+    uint64_t hash;
+    TAILQ_ENTRY(ldo_input) link;
+};
+
+/*
+ * Queue of every loaded input object, kept
+ * in command line order.
+ *
+ * @q: TAILQ head.
+ * @count: Number of inputs.
+ */
+struct ldo_inputq {
+    TAILQ_HEAD(, ldo_input) q;
+    size_t count;
+};
+
+struct ldo_input *ldo_input_new(const char *pathname, struct ldo_file *lfp,
+    const struct ldo_elfdesc *dp);
+void ldo_input_free(struct ldo_input *in);
+struct ldo_isec *ldo_input_symsec(struct ldo_input *in, size_t symidx);
+const char *ldo_input_symname(struct ldo_input *in, size_t symidx);
+void ldo_input_reset(struct ldo_input *in);
+uint64_t ldo_isec_hash(struct ldo_isec *isp);
+
+#endif  /* !LDO_INPUT_H_ */
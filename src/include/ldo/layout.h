@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_LAYOUT_H_
+#define LDO_LAYOUT_H_
+
+#include <stddef.h>
+#include <ldo/output.h>
+#include <ldo/input.h>
+
+/* Address the image is laid out at */
+#define LDO_BASE_ADDR 0x400000
+
+/* Loadable segment alignment, normal and --hugepage-align */
+#define LDO_PAGE_SIZE 0x1000
+#define LDO_HUGEPAGE_SIZE 0x200000
+
+/* Input sections laid out per work item */
+#define LDO_LAYOUT_CHUNK 4096
+
+struct ldo_osec *ldo_osec_new(struct ldo_output *op, const char *name,
+    Elf64_Word type, Elf64_Xword flags);
+int ldo_layout_group(struct ldo_output *op, struct ldo_inputq *iq);
+int ldo_layout_size(struct ldo_output *op);
+int ldo_layout_assign(struct ldo_output *op);
+
+#endif  /* !LDO_LAYOUT_H_ */
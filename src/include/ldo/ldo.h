@@ -40,6 +40,16 @@
 #define LDO_UNKNOWN         0x0003
 
 #define LDO_F_VERBOSE  (1 << 0)
+#define LDO_F_ICF      (1 << 1)     /* Fold address-safe sections */
+#define LDO_F_ICF_ALL  (1 << 2)     /* Fold every identical section */
+#define LDO_F_BUILD_ID (1 << 3)     /* Emit .note.gnu.build-id */
+#define LDO_F_NO_URING (1 << 4)     /* Read inputs with read() only */
+#define LDO_F_HUGEPAGE (1 << 5)     /* Align segments to huge pages */
+#define LDO_F_ZDEBUG   (1 << 6)     /* Compress .debug_* with zlib */
+#define LDO_F_STRIP_DEBUG (1 << 7)  /* Drop .debug_* when indexing */
+#define LDO_F_STRIP_ALL (1 << 8)    /* Drop every non-alloc section */
+#define LDO_F_TAIL_MERGE (1 << 9)   /* Fold strings into their tails */
+#define LDO_F_NO_RELAX (1 << 10)    /* Keep GOT references as they are */
 
 /* Verbose log */
 #define vlog(...) do {                              \
@@ -51,8 +61,52 @@
 typedef uint16_t ldo_flags_t;
 typedef uint8_t ldo_mach_t;
 
+/*
+ * Linker runtime options that carry a value.
+ *
+ * @out_path: Output image (or NULL).
+ * @manifest_path: Manifest listing more inputs (or NULL).
+ * @order_path: Symbol ordering file (or NULL).
+ * @state_path: Section hash and static array cache (or NULL).
+ * @server_path: Socket to serve links on (or NULL).
+ * @connect_path: Socket of a server to link with (or NULL).
+ * @debug_path: Separate debug file (or NULL).
+ * @map_path: Link map to write (or NULL).
+ * @map_json_path: JSON link map to write (or NULL).
+ * @nthreads: Number of threads (0 for one per CPU).
+ * @objq_cap: Initial object queue capacity (0 to size from inputs).
+ * @readahead: Number of inputs to read ahead (0 to not).
+ */
+struct ldo_opts {
+    const char *out_path;
+    const char *manifest_path;
+    const char *order_path;
+    const char *state_path;
+    const char *server_path;
+    const char *connect_path;
+    const char *debug_path;
+    const char *map_path;
+    const char *map_json_path;
+    size_t nthreads;
+    size_t objq_cap;
+    size_t readahead;
+};
+
+/* Inputs read ahead while loading by default */
+#define LDO_READAHEAD 16
+
+/* Most inputs that can be read ahead */
+#define LDO_MAX_READAHEAD 4096
+
+struct ldo_input;
+struct ldo_manifest;
+
 ldo_flags_t ldo_rtflags(void);
-void ldo_load(const char *pathname);
-int ldo_init(void);
+const struct ldo_opts *ldo_rtopts(void);
+struct ldo_input *ldo_load_obj(const char *pathname, struct ldo_file *lfp);
+int ldo_load_all(const struct ldo_manifest *mp);
+int ldo_link(void);
+void ldo_fini(void);
+int ldo_init(size_t ninputs);
 
 #endif  /* !LDO_H_ */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_MANIFEST_H_
+#define LDO_MANIFEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Nested response files deeper than this are rejected */
+#define LDO_RSP_MAXDEPTH 16
+
+/*
+ * An input listed for a link.
+ *
+ * @pathname: Input pathname.
+ * @size: Size in bytes (0 if unknown).
+ * @hash: Content hash (0 if unknown).
+ */
+struct ldo_mfent {
+    char *pathname;
+    size_t size;
+    uint64_t hash;
+};
+
+/*
+ * Every input of a link, in command line order.
+ *
+ * @ents: Inputs.
+ * @count: Number of inputs.
+ * @cap: Capacity of `ents'.
+ */
+struct ldo_manifest {
+    struct ldo_mfent *ents;
+    size_t count;
+    size_t cap;
+};
+
+int ldo_manifest_add(struct ldo_manifest *mp, const char *pathname,
+    size_t size, uint64_t hash);
+int ldo_manifest_read(struct ldo_manifest *mp, const char *pathname);
+void ldo_manifest_free(struct ldo_manifest *mp);
+
+int ldo_rsp_expand(int argc, char **argv, int *argcp, char ***argvp);
+void ldo_rsp_free(int argc, char **argv, char **orig);
+
+#endif  /* !LDO_MANIFEST_H_ */
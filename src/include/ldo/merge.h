@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_MERGE_H_
+#define LDO_MERGE_H_
+
+#include <sys/queue.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/input.h>
+#include <ldo/output.h>
+
+struct ldo_merge;
+
+/*
+ * A string of a mergeable section.
+ *
+ * @str: First byte of the string.
+ * @len: Length in bytes, terminator included.
+ * @hash: Content hash.
+ * @slot: Slot of the string set holding it.
+ * @out: Offset within the pool.
+ * @owner: Set if this copy is the one written to the pool.
+ */
+struct ldo_piece {
+    const char *str;
+    size_t len;
+    uint64_t hash;
+    size_t slot;
+    uint64_t out;
+    uint8_t owner;
+};
+
+/*
+ * An input section merged into a pool.
+ *
+ * @isp: Input section.
+ * @data: Contents (inflated if it was compressed).
+ * @buf: Inflated copy of the contents (or NULL).
+ * @base: Index of its first string in the pool.
+ * @npiece: Number of strings.
+ * @mp: Pool it was merged into.
+ */
+struct ldo_mergein {
+    struct ldo_isec *isp;
+    const char *data;
+    char *buf;
+    size_t base;
+    size_t npiece;
+    struct ldo_merge *mp;
+};
+
+/*
+ * Pool of unique strings standing in for every
+ * SHF_MERGE|SHF_STRINGS input section of one
+ * output section with the same entry size and
+ * alignment.
+ *
+ * @isec: Section the pool is laid out as.
+ * @entsize: Size of a character.
+ * @ins: Input sections merged into the pool.
+ * @nin: Number of entries in `ins'.
+ * @pieces: Strings of every section in `ins', in order.
+ * @npiece: Number of entries in `pieces'.
+ * @slots: String set, a piece index plus one per slot.
+ * @mask: Number of slots minus one.
+ * @pool: Contents of the pool.
+ * @err: Set by any work item that fails.
+ * @link: Queue link.
+ */
+struct ldo_merge {
+    struct ldo_isec isec;
+    uint64_t entsize;
+    struct ldo_mergein *ins;
+    size_t nin;
+    struct ldo_piece *pieces;
+    size_t npiece;
+    uint64_t *slots;
+    size_t mask;
+    char *pool;
+    int err;
+    TAILQ_ENTRY(ldo_merge) link;
+};
+
+TAILQ_HEAD(ldo_mergeq, ldo_merge);
+
+int ldo_merge_strings(struct ldo_output *op, struct ldo_mergeq *mq);
+int ldo_merge_offset(const struct ldo_isec *isp, uint64_t off,
+    uint64_t *resp);
+void ldo_merge_free(struct ldo_mergeq *mq);
+
+#endif  /* !LDO_MERGE_H_ */
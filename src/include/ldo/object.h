@@ -30,31 +30,66 @@
 #ifndef OBJECT_H_
 #define OBJECT_H_
 
-#include <sys/queue.h>
+#include <pthread.h>
 #include <stddef.h>
-
-/* Pin it here, can be adjusted (XXX: careful!) */
-#define OBJQ_MAXCAP 1024
+#include <stdint.h>
 
 /* Default cap */
 #define OBJQ_CAP 512
 
+/* Largest first segment, the queue grows past it anyway */
+#define OBJQ_MAXCAP (1UL << 20)
+
+/*
+ * Segment `n' of a queue holds `cap << n' objects,
+ * so this is plenty for any address space.
+ */
+#define OBJQ_NSEG 48
+
+/*
+ * Compressed contents of a static array. It belongs
+ * to the input section it was made from and lives as
+ * long as the input does, so a resident server only
+ * ever compresses an array once.
+ *
+ * @cdata: Compressed data buffer.
+ * @size: Size of compressed data.
+ * @blocks: Offset of each block in `cdata', plus
+ *          the end of the last one.
+ * @nblock: Number of blocks.
+ */
+struct sarry_pack {
+    char *cdata;
+    size_t size;
+    uint64_t *blocks;
+    size_t nblock;
+};
+
 /*
  * Represents "static array" objects to be
  * queued up before being injected into its
  * resulting file's .static_array section.
  *
- * @pathname: Object file pathname.
- * @cdata: Compressed data buffer.
+ * @pathname: Object file pathname (NULL if the slot is free).
+ * @name: Array name.
+ * @cdata: Compressed data buffer, borrowed from a sarry_pack.
  * @size: Size of compressed data.
  * @real_size: Size of data when decompressed.
+ * @blocks: Offset of each block in `cdata', plus
+ *          the end of the last one (borrowed too).
+ * @nblock: Number of blocks.
+ * @off: Offset of its blocks in .static_array (0 if
+ *       it was left out as a duplicate).
  */
 struct sarry_obj {
     const char *pathname;
-    const char *cdata;
+    const char *name;
+    char *cdata;
     size_t size;
     size_t real_size;
-    TAILQ_ENTRY(sarry_obj) link;
+    uint64_t *blocks;
+    size_t nblock;
+    uint64_t off;
 };
 
 /*
@@ -63,18 +98,36 @@ struct sarry_obj {
  * objects. Once filled, all compressed objects
  * are injected into a final ELF.
  *
- * @q: TAILQ head.
+ * Objects live in segments that double in size,
+ * growing the queue adds a segment and never moves
+ * objects already in it.
+ *
+ * @segs: Segments, `segs[n]' holds `cap << n' objects.
+ * @nseg: Number of segments allocated.
+ * @next: Index of the next free slot.
  * @count: Number of objects.
- * @cap: Object queue capacity.
+ * @cap: Capacity of the first segment.
+ * @lock: Serializes inserts.
  */
 struct sarry_objq {
-    TAILQ_HEAD(, sarry_obj) q;
+    struct sarry_obj *segs[OBJQ_NSEG];
+    size_t nseg;
+    size_t next;
     size_t count;
     size_t cap;
+    pthread_mutex_t lock;
 };
 
+struct ldo_inputq;
+
 int sarry_init_objq(struct sarry_objq *qp, size_t cap);
-int sarry_objq_in(struct sarry_objq *qp, struct sarry_obj *op);
+struct sarry_obj *sarry_objq_in(struct sarry_objq *qp,
+    const struct sarry_obj *op);
+struct sarry_obj *sarry_objq_get(struct sarry_objq *qp, size_t idx);
 int sarry_objq_flush(struct sarry_objq *qp, struct sarry_obj *op);
 
+int ldo_sarry_collect(struct ldo_inputq *iq, struct sarry_objq *qp);
+void *ldo_sarry_build(struct sarry_objq *qp, uint8_t data, size_t *sizep);
+void ldo_sarry_free(struct sarry_pack *pp);
+
 #endif  /* !OBJECT_H_ */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_OUTPUT_H_
+#define LDO_OUTPUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ldo/elf.h>
+#include <ldo/input.h>
+#include <ldo/object.h>
+
+struct ldo_relax;
+
+/*
+ * Represents a section of the output image
+ * made up of one or more input sections.
+ *
+ * @name: Section name.
+ * @type: SHT_* type.
+ * @flags: SHF_* flags.
+ * @align: Alignment.
+ * @offset: File offset.
+ * @addr: Virtual address (0 if not allocated).
+ * @size: Size in bytes.
+ * @isecs: Input sections, in output order.
+ * @nisec: Number of input sections.
+ * @cap: Capacity of `isecs'.
+ * @name_off: Offset of `name' in .shstrtab.
+ * @data: Contents of a synthetic section (or NULL).
+ * @rank: Position among sections of the same class.
+ * @buf: Buffer freed along with the section (or NULL).
+ * @real_size: Size before compression (0 if not compressed).
+ */
+struct ldo_osec {
+    const char *name;
+    Elf64_Word type;
+    Elf64_Xword flags;
+    Elf64_Xword align;
+    Elf64_Off offset;
+    Elf64_Addr addr;
+    Elf64_Xword size;
+    struct ldo_isec **isecs;
+    size_t nisec;
+    size_t cap;
+    Elf64_Word name_off;
+    const void *data;
+    uint64_t rank;
+    void *buf;
+    Elf64_Xword real_size;
+};
+
+/*
+ * Represents the output image while it
+ * is being written.
+ *
+ * @pathname: Output pathname.
+ * @tmppath: File written until ldo_output_commit() (or NULL).
+ * @fd: Output file descriptor.
+ * @map: Mapped output image.
+ * @size: Size of the image.
+ * @osecs: Output sections.
+ * @nosec: Number of output sections.
+ * @cap: Capacity of `osecs'.
+ * @isecs: Every input section that is copied out.
+ * @nisec: Number of entries in `isecs'.
+ * @shoff: File offset of the section header table.
+ * @phdrs: Program headers.
+ * @nphdr: Number of program headers.
+ * @err: Set by any section that fails to copy.
+ * @relax: GOT relaxation state (NULL to not relax).
+ */
+struct ldo_output {
+    const char *pathname;
+    char *tmppath;
+    int fd;
+    char *map;
+    size_t size;
+    struct ldo_osec *osecs;
+    size_t nosec;
+    size_t cap;
+    struct ldo_isec **isecs;
+    size_t nisec;
+    Elf64_Off shoff;
+    Elf64_Phdr *phdrs;
+    size_t nphdr;
+    int err;
+    struct ldo_relax *relax;
+};
+
+int ldo_output_write(struct ldo_inputq *iq, struct sarry_objq *qp,
+    const char *pathname);
+int ldo_output_map(struct ldo_output *op);
+int ldo_output_commit(struct ldo_output *op);
+void ldo_output_headers(struct ldo_output *op, const struct ldo_input *first,
+    size_t shstrndx);
+char *ldo_output_shstrtab(struct ldo_output *op, size_t *sizep);
+void ldo_output_free(struct ldo_output *op);
+
+#endif  /* !LDO_OUTPUT_H_ */
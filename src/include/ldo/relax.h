@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_RELAX_H_
+#define LDO_RELAX_H_
+
+#include <stddef.h>
+#include <ldo/ldo.h>
+#include <ldo/input.h>
+
+/*
+ * A definition GOT references can resolve to.
+ *
+ * @name: Symbol name (NULL if the slot is free).
+ * @in: Input defining it.
+ * @symidx: Index in the symbol table of `in'.
+ */
+struct ldo_relax_sym {
+    const char *name;
+    struct ldo_input *in;
+    size_t symidx;
+};
+
+/*
+ * State for relaxing GOT references of one link.
+ *
+ * @slots: Global definitions (open addressing).
+ * @nslots: Number of slots.
+ * @count: Number of definitions.
+ * @mach: LDO_* machine type of the link.
+ * @nrelax: Number of references relaxed so far.
+ */
+struct ldo_relax {
+    struct ldo_relax_sym *slots;
+    size_t nslots;
+    size_t count;
+    ldo_mach_t mach;
+    size_t nrelax;
+};
+
+int ldo_relax_init(struct ldo_relax *rp, struct ldo_inputq *iq);
+void ldo_relax_isec(struct ldo_relax *rp, const struct ldo_isec *isp,
+    char *dst);
+void ldo_relax_free(struct ldo_relax *rp);
+
+#endif  /* !LDO_RELAX_H_ */
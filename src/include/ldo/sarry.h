@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_SARRY_H_
+#define LDO_SARRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Layout of the .static_array section, shared by
+ * the linker that writes it and the runtime that
+ * reads it. Everything is in the byte order of the
+ * target and offsets are from the section start:
+ *
+ *      struct sarry_hdr
+ *      struct sarry_ent[narray]    (sorted by hash)
+ *      uint64_t blocks[nblock + 1] (per array)
+ *      names                       (NUL terminated)
+ *      compressed blocks
+ *
+ * Block `i' of an array spans blocks[i] up to
+ * blocks[i + 1] and holds `block_size' bytes of
+ * the array once decompressed, the last one maybe
+ * less. A block that did not shrink is stored as
+ * is, its compressed size equals its real size.
+ */
+
+#define SARRY_SECTION   ".static_array"
+#define SARRY_PREFIX    ".static_array."
+
+#define SARRY_MAGIC     0x59525253U     /* "SRRY" */
+#define SARRY_VERSION   1
+
+/* Codecs */
+#define SARRY_CODEC_LZ4 1
+
+/* Default block size, a multiple of every page size */
+#define SARRY_BLOCK_SIZE (64 * 1024)
+
+/*
+ * Section header.
+ *
+ * @magic: SARRY_MAGIC.
+ * @version: SARRY_VERSION.
+ * @codec: SARRY_CODEC_*.
+ * @narray: Number of arrays.
+ * @block_size: Decompressed size of a block.
+ * @size: Size of the whole section.
+ */
+struct sarry_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t codec;
+    uint32_t narray;
+    uint32_t block_size;
+    uint64_t size;
+};
+
+/*
+ * Index entry of one array.
+ *
+ * @hash: sarry_hash() of the name.
+ * @name: Offset of the name.
+ * @nblock: Number of blocks.
+ * @real_size: Size of the array decompressed.
+ * @blocks: Offset of the block offset table.
+ */
+struct sarry_ent {
+    uint64_t hash;
+    uint32_t name;
+    uint32_t nblock;
+    uint64_t real_size;
+    uint64_t blocks;
+};
+
+/*
+ * Hash of an array name (FNV-1a), the index is
+ * sorted on it.
+ */
+static inline uint64_t
+sarry_hash(const char *name)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+
+    while (*name != '\0') {
+        h ^= (uint8_t)*name++;
+        h *= 0x100000001B3ULL;
+    }
+
+    return h;
+}
+
+#endif  /* !LDO_SARRY_H_ */
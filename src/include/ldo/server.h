@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_SERVER_H_
+#define LDO_SERVER_H_
+
+#include <stdint.h>
+#include <ldo/input.h>
+
+/* Request identification */
+#define LDO_SRV_MAGIC   0x5652534f      /* "OSRV" */
+
+/*
+ * Link request header sent by the client along
+ * with its stdout and stderr (SCM_RIGHTS). It is
+ * followed by `len' bytes holding the working
+ * directory then `argc' arguments, each one NUL
+ * terminated.
+ *
+ * @magic: LDO_SRV_MAGIC
+ * @argc: Number of arguments.
+ * @len: Length of the payload.
+ */
+struct ldo_srv_req {
+    uint32_t magic;
+    uint32_t argc;
+    uint64_t len;
+};
+
+/*
+ * Runs one link for a command line, returns
+ * the exit status.
+ */
+typedef int (*ldo_run_t)(int argc, char **argv);
+
+int ldo_server(const char *sockpath, ldo_run_t run);
+int ldo_client(const char *sockpath, int argc, char **argv);
+struct ldo_input *ldo_cache_get(const char *pathname);
+int ldo_cache_put(struct ldo_input *in);
+
+#endif  /* !LDO_SERVER_H_ */
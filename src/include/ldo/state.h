@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LDO_STATE_H_
+#define LDO_STATE_H_
+
+#include <stdint.h>
+#include <ldo/input.h>
+
+/* State file identification */
+#define LDO_STATE_MAGIC     0x534f444c      /* "LDOS" */
+#define LDO_STATE_VERSION   0x0003
+
+/*
+ * State file header, followed by `count'
+ * entries.
+ *
+ * @magic: LDO_STATE_MAGIC
+ * @version: LDO_STATE_VERSION
+ * @count: Number of input entries.
+ * @saved_ns: Time the state was written.
+ * @block_size: Static array block size (SARRY_BLOCK_SIZE).
+ * @codec: Static array codec (SARRY_CODEC_*).
+ */
+struct ldo_state_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t saved_ns;
+    uint32_t block_size;
+    uint32_t codec;
+};
+
+/*
+ * Per-input state entry, followed by the
+ * pathname (`pathlen' bytes, no NUL), one
+ * content hash per section and `npack' packed
+ * static arrays.
+ *
+ * @pathlen: Length of the pathname.
+ * @nsec: Number of section hashes.
+ * @size: Size of the input.
+ * @mtime_ns: Modification time of the input.
+ * @hash: Content hash given by the manifest (0 if unknown).
+ * @npack: Number of packed static arrays.
+ */
+struct ldo_state_ent {
+    uint32_t pathlen;
+    uint32_t nsec;
+    uint64_t size;
+    uint64_t mtime_ns;
+    uint64_t hash;
+    uint64_t npack;
+};
+
+/*
+ * Static array compressed by the last link,
+ * followed by its block offsets (`nblock' + 1
+ * of them) and the compressed data padded to
+ * 8 bytes.
+ *
+ * @sec: Index of the input section.
+ * @nblock: Number of blocks.
+ * @size: Size of the compressed data.
+ */
+struct ldo_state_pack {
+    uint64_t sec;
+    uint64_t nblock;
+    uint64_t size;
+};
+
+int ldo_state_load(const char *path);
+int ldo_state_apply(struct ldo_input *in);
+int ldo_state_save(const char *path, struct ldo_inputq *iq);
+void ldo_state_free(void);
+
+#endif  /* !LDO_STATE_H_ */
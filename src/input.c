@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ldo/input.h>
+#include <ldo/hash.h>
+#include <ldo/bswap.h>
+#include <ldo/object.h>
+#include <ldo/cdefs.h>
+
+/*
+ * Returns true if [off, off + len) lies within
+ * the input file.
+ */
+static inline int
+in_bounds(const struct ldo_input *in, uint64_t off, uint64_t len)
+{
+    size_t file_size = in->lfp->file_size;
+
+    if (off > file_size)
+        return 0;
+
+    return len <= (file_size - off);
+}
+
+/*
+ * Returns true if a section alignment is one layout
+ * can honour, a power of two (or zero) no larger
+ * than LDO_MAX_ALIGN.
+ */
+static inline int
+in_align_ok(uint64_t align)
+{
+    return (align & (align - 1)) == 0 && align <= LDO_MAX_ALIGN;
+}
+
+/*
+ * Look up a section header table that holds fixed
+ * size entries (symbols, relocations) and return
+ * a pointer to it, or NULL if it is malformed.
+ *
+ * @in: Input object.
+ * @shdr: Section header of the table.
+ * @entsize: Expected entry size.
+ */
+static const void *
+in_table(const struct ldo_input *in, const Elf64_Shdr *shdr, size_t entsize)
+{
+    if (shdr->sh_entsize != entsize)
+        return NULL;
+    if ((shdr->sh_offset & 7) != 0 || (shdr->sh_size % entsize) != 0)
+        return NULL;
+    if (!in_bounds(in, shdr->sh_offset, shdr->sh_size))
+        return NULL;
+
+    return LDO_BUFSTREAM(in->lfp->data) + shdr->sh_offset;
+}
+
+/*
+ * Look up a string table and return it, string tables
+ * must end in a NUL so lookups can never run off the end.
+ *
+ * @in: Input object.
+ * @idx: Section index of the string table.
+ * @sizep: Returns the table size.
+ */
+static const char *
+in_strtab(const struct ldo_input *in, size_t idx, size_t *sizep)
+{
+    const Elf64_Shdr *shdr;
+    const char *p;
+
+    if (idx >= in->nsec)
+        return NULL;
+
+    shdr = &in->shdrs[idx];
+    if (shdr->sh_type != SHT_STRTAB || shdr->sh_size == 0)
+        return NULL;
+    if (!in_bounds(in, shdr->sh_offset, shdr->sh_size))
+        return NULL;
+
+    p = LDO_BUFSTREAM(in->lfp->data) + shdr->sh_offset;
+    if (p[shdr->sh_size - 1] != '\0')
+        return NULL;
+
+    *sizep = shdr->sh_size;
+    return p;
+}
+
+/*
+ * Returns true if a section is stripped by this
+ * link. It is still indexed in full, a server may
+ * reuse the input for a link that keeps it, but it
+ * is never laid out or copied.
+ */
+static int
+in_dead(const Elf64_Shdr *shdr, const char *name)
+{
+    ldo_flags_t flags = ldo_rtflags();
+
+    if ((shdr->sh_flags & SHF_ALLOC) != 0)
+        return 0;
+    if (shdr->sh_type != SHT_PROGBITS)
+        return 0;
+    if ((flags & LDO_F_STRIP_ALL) != 0)
+        return 1;
+    if ((flags & LDO_F_STRIP_DEBUG) == 0)
+        return 0;
+
+    return strncmp(name, ".debug", 6) == 0 || strncmp(name, ".zdebug", 7) == 0;
+}
+
+/*
+ * Look through the Elf64_Chdr of a compressed
+ * section, leaving `data' on the compressed bytes
+ * and `size' at the inflated size. Nothing is
+ * inflated here.
+ */
+static int
+in_chdr(struct ldo_input *in, struct ldo_isec *isp)
+{
+    Elf64_Chdr chdr;
+
+    /* gABI: SHF_COMPRESSED cannot be used with SHF_ALLOC */
+    if ((isp->shdr->sh_flags & SHF_ALLOC) != 0)
+        return -ENOEXEC;
+    if (isp->data == NULL || isp->size < sizeof(chdr))
+        return -ENOEXEC;
+
+    memcpy(&chdr, isp->data, sizeof(chdr));
+    if (in->data != LDO_HOST_DATA) {
+        chdr.ch_type = ldo_bswap32(chdr.ch_type);
+        chdr.ch_size = ldo_bswap64(chdr.ch_size);
+        chdr.ch_addralign = ldo_bswap64(chdr.ch_addralign);
+    }
+
+    if (chdr.ch_type != ELFCOMPRESS_ZLIB) {
+        fprintf(stderr, "ldo: %s: %s: unsupported compression type %u\n",
+            in->pathname, isp->name, chdr.ch_type);
+        return -ENOEXEC;
+    }
+
+    /* Anything claiming more than deflate can expand to is a bomb */
+    isp->zsize = isp->size - sizeof(chdr);
+    if (chdr.ch_size / LDO_MAX_INFLATE > isp->zsize)
+        return -ENOEXEC;
+    if (!in_align_ok(chdr.ch_addralign))
+        return -ENOEXEC;
+
+    isp->data += sizeof(chdr);
+    isp->size = chdr.ch_size;
+    isp->align = chdr.ch_addralign;
+    return 0;
+}
+
+/*
+ * Build the section index of an input: name each
+ * section and hang its relocations off of it.
+ */
+static int
+in_index(struct ldo_input *in)
+{
+    const Elf64_Shdr *shdr;
+    const char *shstrtab;
+    struct ldo_isec *isp, *tgt;
+    size_t shstrsz, i;
+
+    shstrtab = in_strtab(in, in->shstrndx, &shstrsz);
+    if (shstrtab == NULL)
+        return -ENOEXEC;
+
+    for (i = 0; i < in->nsec; ++i) {
+        shdr = &in->shdrs[i];
+        isp = &in->isecs[i];
+
+        isp->in = in;
+        isp->shdr = shdr;
+        isp->index = i;
+        isp->size = shdr->sh_size;
+        isp->align = shdr->sh_addralign;
+        isp->repl = isp;
+        isp->icf_idx = LDO_NOIDX;
+        isp->order = LDO_NOIDX;
+        isp->name = (shdr->sh_name < shstrsz) ? &shstrtab[shdr->sh_name] : "";
+
+        if (shdr->sh_type != SHT_NOBITS && shdr->sh_type != SHT_NULL) {
+            if (!in_bounds(in, shdr->sh_offset, shdr->sh_size))
+                return -ENOEXEC;
+            isp->data = LDO_BUFSTREAM(in->lfp->data) + shdr->sh_offset;
+        } else if (shdr->sh_size > LDO_MAX_NOBITS) {
+            return -ENOEXEC;
+        }
+
+        if (!in_align_ok(isp->align))
+            return -ENOEXEC;
+
+        if ((shdr->sh_flags & SHF_COMPRESSED) != 0 &&
+            shdr->sh_type != SHT_NOBITS && in_chdr(in, isp) < 0)
+            return -ENOEXEC;
+        if (in_dead(shdr, isp->name))
+            isp->flags = LDO_ISEC_DEAD;
+
+        if (shdr->sh_type == SHT_SYMTAB && in->syms == NULL) {
+            in->syms = in_table(in, shdr, sizeof(Elf64_Sym));
+            in->strtab = in_strtab(in, shdr->sh_link, &in->strsz);
+            if (in->syms == NULL || in->strtab == NULL)
+                return -ENOEXEC;
+            in->nsym = shdr->sh_size / sizeof(Elf64_Sym);
+            if (in->data != LDO_HOST_DATA)
+                ldo_bswap_syms((Elf64_Sym *)in->syms, in->nsym);
+        }
+    }
+
+    /* Attach relocations to the sections they apply to */
+    for (i = 0; i < in->nsec; ++i) {
+        shdr = &in->shdrs[i];
+        if (shdr->sh_type != SHT_RELA)
+            continue;
+        if (shdr->sh_info == 0 || shdr->sh_info >= in->nsec)
+            return -ENOEXEC;
+
+        tgt = &in->isecs[shdr->sh_info];
+        tgt->rela = in_table(in, shdr, sizeof(Elf64_Rela));
+        if (tgt->rela == NULL)
+            return -ENOEXEC;
+        tgt->nrela = shdr->sh_size / sizeof(Elf64_Rela);
+        if (in->data != LDO_HOST_DATA)
+            ldo_bswap_relas((Elf64_Rela *)tgt->rela, tgt->nrela);
+    }
+
+    return 0;
+}
+
+/*
+ * Index an input object whose header has already
+ * been checked. The returned input takes ownership
+ * of `lfp'.
+ *
+ * @pathname: Object file pathname.
+ * @lfp: Opened object file.
+ * @dp: Validated descriptor of `lfp'.
+ */
+struct ldo_input *
+ldo_input_new(const char *pathname, struct ldo_file *lfp,
+    const struct ldo_elfdesc *dp)
+{
+    struct ldo_input *in;
+    int err;
+
+    if ((in = calloc(1, sizeof(*in))) == NULL) {
+        fprintf(stderr, "ldo_input_new: out of memory\n");
+        return NULL;
+    }
+
+    in->pathname = pathname;
+    in->lfp = lfp;
+    in->eh = dp->eh;
+    in->mach = dp->mach;
+    in->data = dp->data;
+
+    if (dp->nsec == 0) {
+        return in;
+    }
+
+    in->shdrs = dp->shdrs;
+    in->nsec = dp->nsec;
+    in->shstrndx = dp->shstrndx;
+    in->isecs = calloc(in->nsec, sizeof(*in->isecs));
+    if (in->isecs == NULL) {
+        fprintf(stderr, "ldo_input_new: out of memory\n");
+        free(in);
+        return NULL;
+    }
+
+    if ((err = in_index(in)) < 0) {
+        fprintf(stderr, "ldo_input_new: malformed object \"%s\"\n", pathname);
+        free(in->isecs);
+        free(in);
+        return NULL;
+    }
+
+    return in;
+}
+
+/*
+ * Free an input object along with its backing
+ * file.
+ *
+ * @in: Input to free.
+ */
+void
+ldo_input_free(struct ldo_input *in)
+{
+    size_t i;
+
+    if (in == NULL)
+        return;
+
+    for (i = 0; i < in->nsec; ++i) {
+        ldo_sarry_free(in->isecs[i].pack);
+    }
+
+    ldo_close(in->lfp);
+    free(in->isecs);
+    free(in);
+}
+
+/*
+ * Forget everything the link passes recorded about
+ * an input so it can take part in another link.
+ *
+ * @in: Input to reset.
+ */
+void
+ldo_input_reset(struct ldo_input *in)
+{
+    struct ldo_isec *isp;
+    size_t i;
+
+    for (i = 0; i < in->nsec; ++i) {
+        isp = &in->isecs[i];
+        isp->flags = in_dead(isp->shdr, isp->name) ? LDO_ISEC_DEAD : 0;
+        isp->repl = isp;
+        isp->icf_idx = LDO_NOIDX;
+        isp->order = LDO_NOIDX;
+        isp->osec = NULL;
+        isp->merge = NULL;
+        isp->off = 0;
+    }
+
+    in->flags = 0;
+}
+
+/*
+ * Returns the section a symbol is defined in,
+ * or NULL if it is undefined, absolute, common
+ * or out of range.
+ *
+ * @in: Input object.
+ * @symidx: Symbol table index.
+ */
+struct ldo_isec *
+ldo_input_symsec(struct ldo_input *in, size_t symidx)
+{
+    const Elf64_Sym *sym;
+
+    if (__unlikely(symidx >= in->nsym))
+        return NULL;
+
+    sym = &in->syms[symidx];
+    if (sym->st_shndx == SHN_UNDEF || sym->st_shndx >= SHN_LORESERVE)
+        return NULL;
+    if (sym->st_shndx >= in->nsec)
+        return NULL;
+
+    return &in->isecs[sym->st_shndx];
+}
+
+/*
+ * Returns the name of a symbol, never NULL.
+ *
+ * @in: Input object.
+ * @symidx: Symbol table index.
+ */
+const char *
+ldo_input_symname(struct ldo_input *in, size_t symidx)
+{
+    const Elf64_Sym *sym;
+
+    if (__unlikely(symidx >= in->nsym))
+        return "";
+
+    sym = &in->syms[symidx];
+    if (sym->st_name >= in->strsz)
+        return "";
+
+    return &in->strtab[sym->st_name];
+}
+
+/*
+ * Returns the content hash of a section, computing
+ * it on first use. Never returns zero so zero can
+ * mean "not computed yet".
+ *
+ * @isp: Input section.
+ */
+uint64_t
+ldo_isec_hash(struct ldo_isec *isp)
+{
+    uint64_t h;
+    size_t len;
+
+    if (isp->hash != 0)
+        return isp->hash;
+
+    if (isp->data == NULL)
+        len = 0;
+    else
+        len = (isp->zsize != 0) ? isp->zsize : isp->size;
+
+    /* Compressed sections hash as stored, that is enough to spot changes */
+    h = ldo_hash64(isp->data, len, 0);
+    isp->hash = (h != 0) ? h : 1;
+    return isp->hash;
+}
@@ -0,0 +1,798 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Output section layout. Input sections are sorted into
+ * output sections by a small table of rules, in the spirit
+ * of a default linker script, ordered within them and given
+ * offsets and addresses.
+ *
+ * Offsets within a large output section come from a chunked
+ * parallel prefix sum: every chunk lays itself out from zero
+ * and records its size and largest alignment, the chunks are
+ * placed one after another (aligned to that) and finally every
+ * chunk shifts its sections by where it ended up. As a chunk
+ * starts at a multiple of its largest alignment, the relative
+ * offsets it worked out stay correctly aligned.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/layout.h>
+#include <ldo/hash.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+
+#define ALIGNUP(X, A) (((X) + (A) - 1) & ~((uint64_t)(A) - 1))
+
+/* Classes of input sections that have no rule */
+#define CLS_DROP    (-1)    /* Not part of the image */
+#define CLS_NAMED   (-2)    /* Output section named after it */
+
+/* Rule flags */
+#define LR_SORT     (1 << 0)    /* Free to reorder inputs */
+
+/*
+ * Send every input section called `prefix' or
+ * `prefix.*' to the output section `prefix'.
+ */
+struct layout_rule {
+    const char *prefix;
+    uint32_t flags;
+};
+
+/*
+ * Output sections in the order they appear in the
+ * image, sections without a rule go after these.
+ */
+static const struct layout_rule rules[] = {
+    { ".note",              0 },
+    { ".init",              0 },
+    { ".text",              LR_SORT },
+    { ".fini",              0 },
+    { ".rodata",            LR_SORT },
+    { ".static_array",      0 },
+    { ".eh_frame",          0 },
+    { ".gcc_except_table",  LR_SORT },
+    { ".tdata",             LR_SORT },
+    { ".tbss",              LR_SORT },
+    { ".preinit_array",     0 },
+    { ".init_array",        0 },
+    { ".fini_array",        0 },
+    { ".data.rel.ro",       LR_SORT },
+    { ".data",              LR_SORT },
+    { ".bss",               LR_SORT },
+};
+
+#define NRULES (sizeof(rules) / sizeof(rules[0]))
+
+/*
+ * Output section classes, in image order.
+ */
+#define OCLS_PROGBITS   0   /* Allocated, takes file space */
+#define OCLS_NOBITS     1   /* Allocated, no file space */
+#define OCLS_OTHER      2   /* Not allocated */
+
+/*
+ * Grouping state.
+ *
+ * @ins: Every input.
+ * @base: Index of the first section of each input in `cls'.
+ * @cls: Output section index (or CLS_*) per input section.
+ */
+struct group_ctx {
+    struct ldo_input **ins;
+    size_t *base;
+    int32_t *cls;
+};
+
+/*
+ * Buckets of input sections within an output
+ * section, in the order they are placed.
+ */
+#define BUCKET_ORDERED  0   /* Listed by a profile */
+#define BUCKET_HOT      1   /* .text.hot.* */
+#define BUCKET_NORMAL   2
+#define BUCKET_COLD     3   /* .text.unlikely.*, .text.cold.* */
+
+/*
+ * Entry of an output section being sorted.
+ */
+struct sort_ent {
+    uint32_t bucket;
+    uint32_t order;
+    uint32_t align;
+    size_t pos;
+    struct ldo_isec *isp;
+};
+
+/*
+ * A run of input sections laid out by one work item.
+ *
+ * @start: Offset of the chunk in its output section.
+ * @size: Size of the chunk.
+ * @align: Largest alignment in the chunk.
+ */
+struct layout_chunk {
+    uint64_t start;
+    uint64_t size;
+    uint64_t align;
+};
+
+/*
+ * Prefix sum state of one output section.
+ */
+struct prefix_ctx {
+    struct ldo_osec *osp;
+    struct layout_chunk *chunks;
+};
+
+/*
+ * Returns true if a section is called `prefix'
+ * or `prefix.*'.
+ */
+static inline int
+name_is(const char *name, const char *prefix)
+{
+    size_t len = strlen(prefix);
+
+    if (strncmp(name, prefix, len) != 0)
+        return 0;
+
+    return name[len] == '\0' || name[len] == '.';
+}
+
+/*
+ * Returns the rule an input section falls under,
+ * or -1 if there is none.
+ */
+static int
+rule_match(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < NRULES; ++i) {
+        if (name_is(name, rules[i].prefix))
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ * Returns true if an input section ends up
+ * in the output image.
+ */
+static int
+layout_wanted(const struct ldo_isec *isp)
+{
+    switch (isp->shdr->sh_type) {
+    case SHT_PROGBITS:
+    case SHT_NOBITS:
+    case SHT_NOTE:
+    case SHT_INIT_ARRAY:
+    case SHT_FINI_ARRAY:
+    case SHT_PREINIT_ARRAY:
+        break;
+    default:
+        return 0;
+    }
+
+    if (isp->size == 0)
+        return 0;
+
+    return (isp->flags & (LDO_ISEC_FOLDED | LDO_ISEC_SARRY |
+        LDO_ISEC_DEAD)) == 0;
+}
+
+static inline uint64_t
+isec_align(const struct ldo_isec *isp)
+{
+    return isp->align ? isp->align : 1;
+}
+
+/*
+ * Add a new, empty output section.
+ *
+ * @op: Output image.
+ * @name: Section name.
+ * @type: SHT_* type.
+ * @flags: SHF_* flags.
+ */
+struct ldo_osec *
+ldo_osec_new(struct ldo_output *op, const char *name, Elf64_Word type,
+    Elf64_Xword flags)
+{
+    struct ldo_osec *osp;
+    size_t cap;
+    int rule;
+
+    if (op->nosec == op->cap) {
+        cap = op->cap ? op->cap * 2 : 16;
+        osp = realloc(op->osecs, cap * sizeof(*osp));
+        if (osp == NULL)
+            return NULL;
+        op->osecs = osp;
+        op->cap = cap;
+    }
+
+    if ((rule = rule_match(name)) < 0)
+        rule = NRULES;
+
+    osp = &op->osecs[op->nosec];
+    memset(osp, 0, sizeof(*osp));
+    osp->name = name;
+    osp->type = type;
+    osp->flags = flags;
+    osp->align = 1;
+    osp->rank = ((uint64_t)rule << 32) | op->nosec;
+    ++op->nosec;
+    return osp;
+}
+
+/*
+ * Work out where every section of one input goes,
+ * runs on the worker pool.
+ */
+static void
+group_work(size_t idx, void *arg)
+{
+    struct group_ctx *ctx = arg;
+    struct ldo_input *in = ctx->ins[idx];
+    int32_t *cls = &ctx->cls[ctx->base[idx]];
+    struct ldo_isec *isp;
+    size_t i;
+    int rule;
+
+    for (i = 0; i < in->nsec; ++i) {
+        isp = &in->isecs[i];
+        if (!layout_wanted(isp)) {
+            cls[i] = CLS_DROP;
+            continue;
+        }
+
+        rule = rule_match(isp->name);
+        cls[i] = (rule < 0) ? CLS_NAMED : rule;
+    }
+}
+
+/*
+ * Find the output section named after an input
+ * section with no rule, creating it if needed.
+ *
+ * @op: Output image.
+ * @slots: Open addressed table of output section
+ *         indices plus one.
+ * @mask: Size of `slots' minus one.
+ * @name: Section name.
+ */
+static ssize_t
+group_named(struct ldo_output *op, uint32_t *slots, size_t mask,
+    const char *name)
+{
+    size_t i;
+
+    i = ldo_hash64(name, strlen(name), 0) & mask;
+    while (slots[i] != 0) {
+        if (strcmp(op->osecs[slots[i] - 1].name, name) == 0)
+            return slots[i] - 1;
+        i = (i + 1) & mask;
+    }
+
+    if (ldo_osec_new(op, name, 0, 0) == NULL)
+        return -ENOMEM;
+
+    slots[i] = op->nosec;
+    return op->nosec - 1;
+}
+
+/*
+ * Group input sections into output sections. Within
+ * an output section inputs stay in command line order.
+ *
+ * @op: Output image.
+ * @iq: Every input of this link.
+ */
+int
+ldo_layout_group(struct ldo_output *op, struct ldo_inputq *iq)
+{
+    struct group_ctx ctx;
+    struct ldo_input *in;
+    struct ldo_osec *osp;
+    struct ldo_isec *isp;
+    uint32_t *slots = NULL;
+    ssize_t rule_osec[NRULES];
+    size_t nin = 0, nisec = 0, nslots = 16;
+    size_t i, j, k;
+    ssize_t idx;
+    int32_t *cls;
+    int err = -ENOMEM;
+
+    ctx.ins = calloc(iq->count + 1, sizeof(*ctx.ins));
+    ctx.base = calloc(iq->count + 1, sizeof(*ctx.base));
+    if (ctx.ins == NULL || ctx.base == NULL)
+        goto done;
+
+    TAILQ_FOREACH(in, &iq->q, link) {
+        ctx.ins[nin] = in;
+        ctx.base[nin++] = nisec;
+        nisec += in->nsec;
+    }
+
+    if ((ctx.cls = calloc(nisec + 1, sizeof(*ctx.cls))) == NULL)
+        goto done;
+
+    ldo_parallel_for(nin, group_work, &ctx);
+
+    /* Turn classes into output section indices and count */
+    while (nslots < nisec * 2)
+        nslots <<= 1;
+    if ((slots = calloc(nslots, sizeof(*slots))) == NULL)
+        goto done;
+    for (i = 0; i < NRULES; ++i) {
+        rule_osec[i] = -1;
+    }
+
+    cls = ctx.cls;
+    for (i = 0; i < nin; ++i) {
+        in = ctx.ins[i];
+        for (j = 0; j < in->nsec; ++j, ++cls) {
+            if (*cls == CLS_DROP)
+                continue;
+
+            isp = &in->isecs[j];
+            if (*cls == CLS_NAMED) {
+                idx = group_named(op, slots, nslots - 1, isp->name);
+            } else if ((idx = rule_osec[*cls]) < 0) {
+                osp = ldo_osec_new(op, rules[*cls].prefix, 0, 0);
+                idx = (osp == NULL) ? -ENOMEM : (ssize_t)op->nosec - 1;
+                rule_osec[*cls] = idx;
+            }
+
+            if (idx < 0)
+                goto done;
+
+            *cls = idx;
+            ++op->osecs[idx].nisec;
+        }
+    }
+
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        osp->isecs = calloc(osp->nisec + 1, sizeof(*osp->isecs));
+        if (osp->isecs == NULL)
+            goto done;
+        osp->cap = osp->nisec;
+        osp->nisec = 0;
+    }
+
+    /* Fill them in, in command line order */
+    cls = ctx.cls;
+    for (i = 0; i < nin; ++i) {
+        in = ctx.ins[i];
+        for (j = 0; j < in->nsec; ++j, ++cls) {
+            if (*cls < 0)
+                continue;
+
+            isp = &in->isecs[j];
+            osp = &op->osecs[*cls];
+            osp->isecs[osp->nisec++] = isp;
+            k = isec_align(isp);
+            if (k > osp->align)
+                osp->align = k;
+
+            /* Anything with data makes the whole section take space */
+            if (osp->type == 0 || isp->shdr->sh_type != SHT_NOBITS)
+                osp->type = isp->shdr->sh_type;
+
+            /* Compressed inputs are written out inflated */
+            osp->flags |= isp->shdr->sh_flags &
+                ~(Elf64_Xword)(SHF_GROUP | SHF_COMPRESSED);
+            ++op->nisec;
+        }
+    }
+
+    err = 0;
+done:
+    if (err < 0)
+        fprintf(stderr, "ldo_layout_group: out of memory\n");
+    free(ctx.ins);
+    free(ctx.base);
+    free(ctx.cls);
+    free(slots);
+    return err;
+}
+
+/*
+ * Returns the bucket an input section goes in. The
+ * compiler marks functions it knows to be hot or cold
+ * through their section name.
+ */
+static uint32_t
+sort_bucket(const struct ldo_isec *isp)
+{
+    if (isp->order != LDO_NOIDX)
+        return BUCKET_ORDERED;
+    if (name_is(isp->name, ".text.hot"))
+        return BUCKET_HOT;
+    if (name_is(isp->name, ".text.unlikely") ||
+        name_is(isp->name, ".text.cold"))
+        return BUCKET_COLD;
+
+    return BUCKET_NORMAL;
+}
+
+static int
+sort_cmp(const void *a, const void *b)
+{
+    const struct sort_ent *ea = a, *eb = b;
+
+    if (ea->bucket != eb->bucket)
+        return (ea->bucket < eb->bucket) ? -1 : 1;
+    if (ea->order != eb->order)
+        return (ea->order < eb->order) ? -1 : 1;
+
+    /* Largest alignment first keeps padding down */
+    if (ea->align != eb->align)
+        return (ea->align > eb->align) ? -1 : 1;
+
+    return (ea->pos < eb->pos) ? -1 : 1;
+}
+
+/*
+ * Order the inputs of one output section, runs on
+ * the worker pool. Sections listed by a profile go
+ * first in its order, then hot, normal and cold
+ * sections, each of those by alignment.
+ */
+static void
+sort_work(size_t idx, void *arg)
+{
+    struct ldo_output *op = arg;
+    struct ldo_osec *osp = &op->osecs[idx];
+    struct sort_ent *ents;
+    size_t i;
+    int rule;
+
+    if (osp->nisec < 2)
+        return;
+    if ((rule = rule_match(osp->name)) < 0 || !(rules[rule].flags & LR_SORT))
+        return;
+    if ((ents = malloc(osp->nisec * sizeof(*ents))) == NULL)
+        return;
+
+    for (i = 0; i < osp->nisec; ++i) {
+        ents[i].bucket = sort_bucket(osp->isecs[i]);
+        ents[i].order = osp->isecs[i]->order;
+        ents[i].align = isec_align(osp->isecs[i]);
+        ents[i].pos = i;
+        ents[i].isp = osp->isecs[i];
+    }
+
+    qsort(ents, osp->nisec, sizeof(*ents), sort_cmp);
+    for (i = 0; i < osp->nisec; ++i) {
+        osp->isecs[i] = ents[i].isp;
+    }
+
+    free(ents);
+}
+
+/*
+ * Lay out one chunk from offset zero.
+ */
+static void
+prefix_local(size_t idx, void *arg)
+{
+    struct prefix_ctx *ctx = arg;
+    struct layout_chunk *cp = &ctx->chunks[idx];
+    struct ldo_osec *osp = ctx->osp;
+    struct ldo_isec *isp;
+    uint64_t off = 0, align;
+    size_t i, end;
+
+    cp->align = 1;
+    end = (idx + 1) * LDO_LAYOUT_CHUNK;
+    if (end > osp->nisec)
+        end = osp->nisec;
+
+    for (i = idx * LDO_LAYOUT_CHUNK; i < end; ++i) {
+        isp = osp->isecs[i];
+        align = isec_align(isp);
+        if (align > cp->align)
+            cp->align = align;
+
+        isp->osec = osp;
+        isp->off = ALIGNUP(off, align);
+        off = isp->off + isp->size;
+    }
+
+    cp->size = off;
+}
+
+/*
+ * Move a chunk to where it ended up.
+ */
+static void
+prefix_shift(size_t idx, void *arg)
+{
+    struct prefix_ctx *ctx = arg;
+    struct layout_chunk *cp = &ctx->chunks[idx];
+    struct ldo_osec *osp = ctx->osp;
+    size_t i, end;
+
+    if (cp->start == 0)
+        return;
+
+    end = (idx + 1) * LDO_LAYOUT_CHUNK;
+    if (end > osp->nisec)
+        end = osp->nisec;
+
+    for (i = idx * LDO_LAYOUT_CHUNK; i < end; ++i) {
+        osp->isecs[i]->off += cp->start;
+    }
+}
+
+/*
+ * Give every input section of an output section
+ * its offset and work out the section size.
+ */
+static int
+layout_osec(struct ldo_osec *osp)
+{
+    struct prefix_ctx ctx;
+    struct layout_chunk one;
+    size_t i, nchunk;
+    uint64_t off = 0;
+
+    if (osp->data != NULL || osp->nisec == 0)
+        return 0;
+
+    nchunk = (osp->nisec + LDO_LAYOUT_CHUNK - 1) / LDO_LAYOUT_CHUNK;
+    ctx.osp = osp;
+    ctx.chunks = &one;
+    if (nchunk > 1 && (ctx.chunks = calloc(nchunk, sizeof(one))) == NULL)
+        return -ENOMEM;
+
+    ldo_parallel_for(nchunk, prefix_local, &ctx);
+    for (i = 0; i < nchunk; ++i) {
+        off = ALIGNUP(off, ctx.chunks[i].align);
+        ctx.chunks[i].start = off;
+        off += ctx.chunks[i].size;
+    }
+
+    ldo_parallel_for(nchunk, prefix_shift, &ctx);
+    osp->size = off;
+
+    if (ctx.chunks != &one)
+        free(ctx.chunks);
+    return 0;
+}
+
+static int
+osec_class(const struct ldo_osec *osp)
+{
+    if ((osp->flags & SHF_ALLOC) == 0)
+        return OCLS_OTHER;
+
+    return (osp->type == SHT_NOBITS) ? OCLS_NOBITS : OCLS_PROGBITS;
+}
+
+static int
+osec_cmp(const void *a, const void *b)
+{
+    const struct ldo_osec *oa = a, *ob = b;
+    int ca = osec_class(oa), cb = osec_class(ob);
+
+    if (ca != cb)
+        return ca - cb;
+
+    return (oa->rank < ob->rank) ? -1 : (oa->rank > ob->rank);
+}
+
+static Elf64_Word
+osec_perm(const struct ldo_osec *osp)
+{
+    Elf64_Word perm = PF_R;
+
+    if ((osp->flags & SHF_WRITE) != 0)
+        perm |= PF_W;
+    if ((osp->flags & SHF_EXECINSTR) != 0)
+        perm |= PF_X;
+    return perm;
+}
+
+/*
+ * Count the program headers the sorted output needs:
+ * one PT_LOAD for the headers, one more every time
+ * the permissions change, and PT_GNU_STACK.
+ *
+ * @op: Output image, in image order.
+ */
+static size_t
+layout_nphdr(const struct ldo_output *op)
+{
+    const struct ldo_osec *osp;
+    Elf64_Word perm = PF_R;
+    size_t i, n = 2;
+
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        if (osec_class(osp) == OCLS_OTHER)
+            continue;
+        if (osec_perm(osp) != perm) {
+            perm = osec_perm(osp);
+            ++n;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Put the output sections in image order and lay
+ * out the input sections of each one, which fixes
+ * the size of every output section. Their contents
+ * may still be replaced before ldo_layout_assign().
+ *
+ * @op: Output image.
+ */
+int
+ldo_layout_size(struct ldo_output *op)
+{
+    struct ldo_osec *osp;
+    size_t i, j, n = 0;
+    int err;
+
+    ldo_parallel_for(op->nosec, sort_work, op);
+    qsort(op->osecs, op->nosec, sizeof(*op->osecs), osec_cmp);
+
+    free(op->isecs);
+    op->isecs = calloc(op->nisec + 1, sizeof(*op->isecs));
+    if (op->isecs == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        if ((err = layout_osec(osp)) < 0)
+            return err;
+
+        for (j = 0; j < osp->nisec; ++j) {
+            op->isecs[n++] = osp->isecs[j];
+        }
+    }
+
+    op->nisec = n;
+    return 0;
+}
+
+/*
+ * Give every output section an offset and an
+ * address, after ldo_layout_size(). Allocated
+ * sections are split into PT_LOAD segments by their
+ * permissions, each starting on its own page so the
+ * offset and address stay congruent. With huge page
+ * alignment every segment, the text in particular,
+ * starts and ends on a 2 MiB boundary so it can be
+ * remapped onto huge pages at startup; hot text is
+ * sorted to the front and lands in the first one.
+ * Sets the image size, section header table offset
+ * and program headers.
+ *
+ * @op: Output image.
+ */
+int
+ldo_layout_assign(struct ldo_output *op)
+{
+    struct ldo_osec *osp;
+    Elf64_Phdr *ph;
+    Elf64_Word perm;
+    uint64_t off, vaddr, page = LDO_PAGE_SIZE;
+    size_t i;
+    int cls;
+
+    if ((ldo_rtflags() & LDO_F_HUGEPAGE) != 0)
+        page = LDO_HUGEPAGE_SIZE;
+
+    free(op->phdrs);
+    op->nphdr = layout_nphdr(op);
+    op->phdrs = calloc(op->nphdr, sizeof(*op->phdrs));
+    if (op->phdrs == NULL)
+        return -ENOMEM;
+
+    /* The first segment maps the ELF and program headers */
+    off = sizeof(Elf64_Ehdr) + op->nphdr * sizeof(Elf64_Phdr);
+    vaddr = LDO_BASE_ADDR + off;
+    ph = &op->phdrs[0];
+    ph->p_type = PT_LOAD;
+    ph->p_flags = PF_R;
+    ph->p_vaddr = LDO_BASE_ADDR;
+    ph->p_paddr = LDO_BASE_ADDR;
+    ph->p_filesz = off;
+    ph->p_memsz = off;
+    ph->p_align = page;
+
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        cls = osec_class(osp);
+        perm = osec_perm(osp);
+        if (cls != OCLS_OTHER && perm != ph->p_flags) {
+            ++ph;
+            ph->p_type = PT_LOAD;
+            ph->p_flags = perm;
+            ph->p_align = page;
+            if (cls == OCLS_PROGBITS) {
+                off = ALIGNUP(off, page);
+                vaddr = LDO_BASE_ADDR + off;
+                ph->p_offset = off;
+            } else {
+                /* Nothing in the file, keep it congruent anyway */
+                vaddr = ALIGNUP(vaddr, page);
+                ph->p_offset = off & ~(page - 1);
+            }
+            ph->p_vaddr = vaddr;
+            ph->p_paddr = vaddr;
+        }
+
+        switch (cls) {
+        case OCLS_PROGBITS:
+            osp->offset = ALIGNUP(off, osp->align);
+            osp->addr = LDO_BASE_ADDR + osp->offset;
+            off = osp->offset + osp->size;
+            vaddr = LDO_BASE_ADDR + off;
+            ph->p_filesz = off - ph->p_offset;
+            ph->p_memsz = vaddr - ph->p_vaddr;
+            break;
+        case OCLS_NOBITS:
+            vaddr = ALIGNUP(vaddr, osp->align);
+            osp->offset = off;
+            osp->addr = vaddr;
+            vaddr += osp->size;
+            ph->p_memsz = vaddr - ph->p_vaddr;
+            break;
+        default:
+            osp->offset = ALIGNUP(off, osp->align);
+            osp->addr = 0;
+            off = osp->offset + osp->size;
+            break;
+        }
+    }
+
+    ph = &op->phdrs[op->nphdr - 1];
+    ph->p_type = PT_GNU_STACK;
+    ph->p_flags = PF_R | PF_W;
+    ph->p_align = 16;
+
+    op->shoff = ALIGNUP(off, 8);
+    op->size = op->shoff + (op->nosec + 1) * sizeof(Elf64_Shdr);
+    return 0;
+}
@@ -27,17 +27,200 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/errno.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <ldo/file.h>
 #include <ldo/ldo.h>
+#include <ldo/thread.h>
+#include <ldo/server.h>
+#include <ldo/manifest.h>
+#include <ldo/uring.h>
+#include <ldo/object.h>
+
+/* Long-only options */
+#define OPT_ICF     0x100
+#define OPT_HASHCACHE 0x101
+#define OPT_SERVER  0x102
+#define OPT_CONNECT 0x103
+#define OPT_BUILDID 0x104
+#define OPT_MANIFEST 0x105
+#define OPT_OBJQCAP 0x106
+#define OPT_READAHEAD 0x107
+#define OPT_NOURING 0x108
+#define OPT_ORDER   0x109
+#define OPT_HUGEPAGE 0x10A
+#define OPT_ZDEBUG  0x10B
+#define OPT_SPLITDBG 0x10C
+#define OPT_TAILMERGE 0x10D
+#define OPT_MAPJSON 0x10E
+#define OPT_NORELAX 0x10F
 
 static ldo_flags_t flags = 0;
+static struct ldo_opts opts;
+
+static const struct option longopts[] = {
+    { "help",       no_argument,        NULL, 'h' },
+    { "output",     required_argument,  NULL, 'o' },
+    { "verbose",    no_argument,        NULL, 'v' },
+    { "threads",    required_argument,  NULL, 'j' },
+    { "icf",        required_argument,  NULL, OPT_ICF },
+    { "hash-cache", required_argument,  NULL, OPT_HASHCACHE },
+    { "server",     required_argument,  NULL, OPT_SERVER },
+    { "connect",    required_argument,  NULL, OPT_CONNECT },
+    { "build-id",   no_argument,        NULL, OPT_BUILDID },
+    { "manifest",   required_argument,  NULL, OPT_MANIFEST },
+    { "objq-cap",   required_argument,  NULL, OPT_OBJQCAP },
+    { "readahead",  required_argument,  NULL, OPT_READAHEAD },
+    { "no-io-uring", no_argument,       NULL, OPT_NOURING },
+    { "symbol-ordering-file", required_argument, NULL, OPT_ORDER },
+    { "hugepage-align", no_argument,    NULL, OPT_HUGEPAGE },
+    { "compress-debug-sections", optional_argument, NULL, OPT_ZDEBUG },
+    { "split-debug", required_argument, NULL, OPT_SPLITDBG },
+    { "tail-merge-strings", no_argument, NULL, OPT_TAILMERGE },
+    { "Map",        required_argument,  NULL, 'M' },
+    { "map-json",   required_argument,  NULL, OPT_MAPJSON },
+    { "no-relax",   no_argument,        NULL, OPT_NORELAX },
+    { "strip-debug", no_argument,       NULL, 'S' },
+    { "strip-all",  no_argument,        NULL, 's' },
+    { NULL,         0,                  NULL, 0 }
+};
 
 static void
 usage(const char *argv0)
 {
-    fprintf(stderr, "Usage: %s <*.oo>\n", argv0);
+    fprintf(stderr,
+        "Usage: %s [options] <*.o|*.a|@file>...\n"
+        "  -h, --help           Show this help\n"
+        "  -o, --output <file>  Write the output image to <file>\n"
+        "  -v, --verbose        Verbose output\n"
+        "  -j, --threads <n>    Number of threads (default: all CPUs)\n"
+        "  -S, --strip-debug    Leave .debug_* sections out of the output\n"
+        "  -s, --strip-all      Leave every non-alloc section out of the output\n"
+        "  --icf=<safe|all|none>\n"
+        "                       Fold identical read-only sections\n"
+        "  --hash-cache=<file>  Reuse section hashes and compressed static arrays\n"
+        "                       of unchanged inputs from <file>\n"
+        "  --server=<socket>    Serve links on <socket>, keeping inputs warm\n"
+        "  --connect=<socket>   Run this link on the server at <socket>\n"
+        "  --build-id           Stamp a .note.gnu.build-id into the output\n"
+        "  --manifest=<file>    Also link the inputs listed in <file>\n"
+        "  --objq-cap=<n>       Initial static array queue capacity\n"
+        "  --readahead=<n>      Inputs to read ahead while loading (default: 16)\n"
+        "  --no-io-uring        Read inputs without io_uring\n"
+        "  --symbol-ordering-file=<file>\n"
+        "                       Place sections of the listed symbols first\n"
+        "  --hugepage-align     Align loadable segments to 2 MiB pages\n"
+        "  --compress-debug-sections[=zlib|none]\n"
+        "                       Compress .debug_* sections (default: zlib)\n"
+        "  --split-debug=<file> Write .debug_* sections to <file> instead\n"
+        "  --tail-merge-strings Fold merged strings into ones they end\n"
+        "  -Map=<file>          Write a link map to <file>\n"
+        "  --map-json=<file>    Write a link map as JSON to <file>\n"
+        "  --no-relax           Keep GOT loads instead of making them direct\n"
+        "  @<file>              Read more arguments from <file>\n",
+        argv0);
+}
+
+/*
+ * Parse the argument to --icf
+ */
+static int
+parse_icf(const char *arg)
+{
+    flags &= ~(LDO_F_ICF | LDO_F_ICF_ALL);
+
+    if (strcmp(arg, "safe") == 0) {
+        flags |= LDO_F_ICF;
+    } else if (strcmp(arg, "all") == 0) {
+        flags |= LDO_F_ICF | LDO_F_ICF_ALL;
+    } else if (strcmp(arg, "none") != 0) {
+        fprintf(stderr, "Bad --icf mode: %s\n", arg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse the argument to --compress-debug-sections
+ */
+static int
+parse_zdebug(const char *arg)
+{
+    if (arg == NULL || strcmp(arg, "zlib") == 0) {
+        flags |= LDO_F_ZDEBUG;
+    } else if (strcmp(arg, "none") == 0) {
+        flags &= ~LDO_F_ZDEBUG;
+    } else {
+        fprintf(stderr, "Bad --compress-debug-sections mode: %s\n", arg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse a count given to an option, anything but a
+ * plain number no larger than `max' is refused.
+ *
+ * @opt: Option name, for errors.
+ * @arg: Argument to parse.
+ * @max: Largest value accepted.
+ * @res: Returns the value.
+ */
+static int
+parse_count(const char *opt, const char *arg, size_t max, size_t *res)
+{
+    unsigned long long v;
+    char *end;
+
+    errno = 0;
+    v = strtoull(arg, &end, 0);
+    if (!isdigit((unsigned char)*arg) || *end != '\0' || errno != 0 ||
+        v > max) {
+        fprintf(stderr, "Bad %s: %s (0 to %zu)\n", opt, arg, max);
+        return -1;
+    }
+
+    *res = v;
+    return 0;
+}
+
+/*
+ * Parse -Map, which getopt sees as -M with "ap" in
+ * front of its argument. --Map comes here with just
+ * the file.
+ */
+static int
+parse_map(int argc, char **argv, const char *arg)
+{
+    if (arg != argv[optind - 1] + 2) {
+        opts.map_path = arg;
+        return 0;
+    }
+
+    if (strncmp(arg, "ap", 2) != 0) {
+        fprintf(stderr, "Bad argument: -M%s\n", arg);
+        return -1;
+    }
+
+    arg += 2;
+    if (*arg == '=') {
+        opts.map_path = arg + 1;
+        return 0;
+    }
+    if (*arg != '\0' || optind >= argc) {
+        fprintf(stderr, "-Map needs a file\n");
+        return -1;
+    }
+
+    opts.map_path = argv[optind++];
+    return 0;
 }
 
 /*
@@ -49,38 +232,201 @@ ldo_rtflags(void)
     return flags;
 }
 
-int
-main(int argc, char **argv)
+/*
+ * Get linker runtime options
+ */
+const struct ldo_opts *
+ldo_rtopts(void)
 {
-    char c;
-    int i;
+    return &opts;
+}
 
-    if (argc < 2) {
-        usage(argv[0]);
-        return -1;
-    }
+/*
+ * Parse a command line into the runtime flags and
+ * options. Returns the index of the first input, 0
+ * if there is nothing left to do or -1 on error.
+ */
+static int
+parse_args(int argc, char **argv)
+{
+    int c;
 
-    while ((c = getopt(argc, argv, "hv")) >= 0) {
+    flags = 0;
+    memset(&opts, 0, sizeof(opts));
+    opts.readahead = LDO_READAHEAD;
+    optind = 0;
+
+    while ((c = getopt_long(argc, argv, "ho:vj:SsM:", longopts, NULL)) >= 0) {
         switch (c) {
         case 'h':
             usage(argv[0]);
             return 0;
+        case 'o':
+            opts.out_path = optarg;
+            break;
         case 'v':
             flags |= LDO_F_VERBOSE;
             break;
+        case 'j':
+            if (parse_count("-j", optarg, LDO_MAX_THREADS,
+                &opts.nthreads) < 0)
+                return -1;
+            break;
+        case 'S':
+            flags |= LDO_F_STRIP_DEBUG;
+            break;
+        case 's':
+            flags |= LDO_F_STRIP_DEBUG | LDO_F_STRIP_ALL;
+            break;
+        case OPT_ICF:
+            if (parse_icf(optarg) < 0)
+                return -1;
+            break;
+        case OPT_HASHCACHE:
+            opts.state_path = optarg;
+            break;
+        case OPT_SERVER:
+            opts.server_path = optarg;
+            break;
+        case OPT_CONNECT:
+            opts.connect_path = optarg;
+            break;
+        case OPT_BUILDID:
+            flags |= LDO_F_BUILD_ID;
+            break;
+        case OPT_MANIFEST:
+            opts.manifest_path = optarg;
+            break;
+        case OPT_OBJQCAP:
+            if (parse_count("--objq-cap", optarg, OBJQ_MAXCAP,
+                &opts.objq_cap) < 0)
+                return -1;
+            break;
+        case OPT_READAHEAD:
+            if (parse_count("--readahead", optarg, LDO_MAX_READAHEAD,
+                &opts.readahead) < 0)
+                return -1;
+            break;
+        case OPT_NOURING:
+            flags |= LDO_F_NO_URING;
+            break;
+        case OPT_ORDER:
+            opts.order_path = optarg;
+            break;
+        case OPT_HUGEPAGE:
+            flags |= LDO_F_HUGEPAGE;
+            break;
+        case OPT_ZDEBUG:
+            if (parse_zdebug(optarg) < 0)
+                return -1;
+            break;
+        case OPT_SPLITDBG:
+            opts.debug_path = optarg;
+            break;
+        case OPT_TAILMERGE:
+            flags |= LDO_F_TAIL_MERGE;
+            break;
+        case 'M':
+            if (parse_map(argc, argv, optarg) < 0)
+                return -1;
+            break;
+        case OPT_MAPJSON:
+            opts.map_json_path = optarg;
+            break;
+        case OPT_NORELAX:
+            flags |= LDO_F_NO_RELAX;
+            break;
         case '?':
             fprintf(stderr, "Bad argument: -%c\n", optopt);
             break;
         }
     }
 
-    ldo_init();
+    return optind;
+}
+
+/*
+ * Link every input from argv[first] onwards
+ */
+static int
+do_link(int argc, char **argv, int first)
+{
+    struct ldo_manifest mf = { NULL, 0, 0 };
+    int i, err = 0;
+
+    for (i = first; i < argc && err == 0; ++i) {
+        err = ldo_manifest_add(&mf, argv[i], 0, 0);
+    }
+
+    if (err == 0 && opts.manifest_path != NULL)
+        err = ldo_manifest_read(&mf, opts.manifest_path);
 
-    /* Load object files */
-    if (optind < argc) {
-        for (i = optind; i < argc; ++i) {
-            ldo_load(argv[i]);
+    if (err == 0 && (err = ldo_init(mf.count)) == 0) {
+        if ((err = ldo_load_all(&mf)) == 0) {
+            err = ldo_link();
+        } else {
+            ldo_fini();
         }
     }
-    return 0;
+
+    ldo_manifest_free(&mf);
+    return err;
+}
+
+/*
+ * Run a single link for a command line, the
+ * server calls this for every request.
+ */
+static int
+run_link(int argc, char **argv)
+{
+    char **args;
+    int nargs, first;
+
+    if ((first = ldo_rsp_expand(argc, argv, &nargs, &args)) < 0)
+        return first;
+
+    if ((first = parse_args(nargs, args)) > 0)
+        first = do_link(nargs, args, first);
+
+    ldo_rsp_free(nargs, args, argv);
+    return first;
+}
+
+int
+main(int argc, char **argv)
+{
+    char **args;
+    int nargs, first, err;
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if ((err = ldo_rsp_expand(argc, argv, &nargs, &args)) < 0)
+        return err;
+
+    if ((first = parse_args(nargs, args)) <= 0) {
+        ldo_rsp_free(nargs, args, argv);
+        return first;
+    }
+
+    if (opts.connect_path != NULL) {
+        err = ldo_client(opts.connect_path, nargs, args);
+        ldo_rsp_free(nargs, args, argv);
+        return err;
+    }
+
+    ldo_thread_init(opts.nthreads);
+    if (opts.server_path != NULL) {
+        err = ldo_server(opts.server_path, run_link);
+    } else {
+        err = do_link(nargs, args, first);
+    }
+
+    ldo_thread_fini();
+    ldo_uring_fini();
+    ldo_rsp_free(nargs, args, argv);
+    return err;
 }
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Input lists that do not fit on a command line. Response
+ * files (@file) are expanded into argv before options are
+ * parsed and a manifest lists inputs with their sizes so
+ * the loader can size its tables and balance its work
+ * before touching any of them.
+ *
+ * A manifest is plain text, one input per line:
+ *
+ *      <size> <hash> <pathname>
+ *
+ * where <size> is decimal, <hash> is up to 64 bits of
+ * hex (with or without a leading 0x), either may be
+ * "-" if not known, and <pathname> runs to the end of
+ * the line. Blank lines and lines starting with '#'
+ * are ignored. <hash> is whatever content hash the
+ * build system keeps, ldo
+ * only compares it with the one --hash-cache recorded
+ * for the same input. Entries are never dropped for
+ * sharing a hash, the same object may well be listed
+ * twice on purpose.
+ */
+
+#include <sys/errno.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/manifest.h>
+
+/*
+ * Argument vector being built up.
+ */
+struct rsp_args {
+    char **v;
+    int n;
+    int cap;
+};
+
+/*
+ * Add an input to a manifest.
+ *
+ * @mp: Manifest to add to.
+ * @pathname: Input pathname, copied.
+ * @size: Size in bytes (0 if unknown).
+ * @hash: Content hash (0 if unknown).
+ */
+int
+ldo_manifest_add(struct ldo_manifest *mp, const char *pathname,
+    size_t size, uint64_t hash)
+{
+    struct ldo_mfent *ent;
+    size_t cap;
+
+    if (mp->count == mp->cap) {
+        cap = mp->cap ? mp->cap * 2 : 64;
+        ent = realloc(mp->ents, cap * sizeof(*ent));
+        if (ent == NULL)
+            return -ENOMEM;
+        mp->ents = ent;
+        mp->cap = cap;
+    }
+
+    ent = &mp->ents[mp->count];
+    if ((ent->pathname = strdup(pathname)) == NULL)
+        return -ENOMEM;
+
+    ent->size = size;
+    ent->hash = hash;
+    ++mp->count;
+    return 0;
+}
+
+/*
+ * Parse a size or hash column, "-" means unknown.
+ *
+ * @pp: Column, left just past it.
+ * @base: 10 for a size, 16 for a hash.
+ * @res: Set to the value.
+ */
+static int
+mf_field(char **pp, int base, uint64_t *res)
+{
+    char *p = *pp, *end;
+
+    while (isblank((unsigned char)*p))
+        ++p;
+
+    if (*p == '-') {
+        *res = 0;
+        end = p + 1;
+    } else {
+        if (!isxdigit((unsigned char)*p))
+            return -1;
+        errno = 0;
+        *res = strtoull(p, &end, base);
+        if (end == p || errno != 0)
+            return -1;
+    }
+
+    if (!isblank((unsigned char)*end))
+        return -1;
+
+    *pp = end;
+    return 0;
+}
+
+/*
+ * Read a manifest and append its inputs.
+ *
+ * @mp: Manifest to add to.
+ * @pathname: Manifest file.
+ */
+int
+ldo_manifest_read(struct ldo_manifest *mp, const char *pathname)
+{
+    FILE *fp;
+    char *line = NULL, *p, *end;
+    size_t linecap = 0, lineno = 0;
+    uint64_t size, hash;
+    ssize_t len;
+    int err = 0;
+
+    if ((fp = fopen(pathname, "r")) == NULL) {
+        fprintf(stderr, "ldo_manifest_read: cannot open \"%s\"\n", pathname);
+        return -ENOENT;
+    }
+
+    while ((len = getline(&line, &linecap, fp)) >= 0) {
+        ++lineno;
+        while (len > 0 && isspace((unsigned char)line[len - 1]))
+            line[--len] = '\0';
+
+        p = line;
+        while (isblank((unsigned char)*p))
+            ++p;
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        if (mf_field(&p, 10, &size) < 0 || mf_field(&p, 16, &hash) < 0) {
+            fprintf(stderr, "%s:%zu: bad manifest entry\n", pathname, lineno);
+            err = -EINVAL;
+            break;
+        }
+
+        while (isblank((unsigned char)*p))
+            ++p;
+        end = p + strlen(p);
+        if (p == end) {
+            fprintf(stderr, "%s:%zu: missing pathname\n", pathname, lineno);
+            err = -EINVAL;
+            break;
+        }
+
+        if ((err = ldo_manifest_add(mp, p, size, hash)) < 0)
+            break;
+    }
+
+    free(line);
+    fclose(fp);
+    return err;
+}
+
+void
+ldo_manifest_free(struct ldo_manifest *mp)
+{
+    size_t i;
+
+    for (i = 0; i < mp->count; ++i) {
+        free(mp->ents[i].pathname);
+    }
+
+    free(mp->ents);
+    mp->ents = NULL;
+    mp->count = 0;
+    mp->cap = 0;
+}
+
+static int
+rsp_push(struct rsp_args *ap, const char *arg)
+{
+    char **v;
+    int cap;
+
+    /* Always leave room for the NULL terminator */
+    if (ap->n + 1 >= ap->cap) {
+        cap = ap->cap ? ap->cap * 2 : 64;
+        if ((v = realloc(ap->v, cap * sizeof(*v))) == NULL)
+            return -ENOMEM;
+        ap->v = v;
+        ap->cap = cap;
+    }
+
+    if ((ap->v[ap->n] = strdup(arg)) == NULL)
+        return -ENOMEM;
+
+    ap->v[++ap->n] = NULL;
+    return 0;
+}
+
+static int rsp_arg(struct rsp_args *ap, const char *arg, int depth);
+
+/*
+ * Split the contents of a response file into arguments.
+ * Arguments are separated by whitespace, quotes group and
+ * a backslash escapes the next character. Unquoting is
+ * done in place.
+ */
+static int
+rsp_split(struct rsp_args *ap, char *p, int depth)
+{
+    char *q, *tok;
+    char quote;
+    int err;
+
+    for (;;) {
+        while (isspace((unsigned char)*p))
+            ++p;
+        if (*p == '\0')
+            break;
+
+        tok = q = p;
+        quote = '\0';
+        while (*p != '\0') {
+            if (quote == '\0' && isspace((unsigned char)*p))
+                break;
+
+            if (*p == '\\' && p[1] != '\0') {
+                *q++ = p[1];
+                p += 2;
+            } else if (quote != '\0' && *p == quote) {
+                quote = '\0';
+                ++p;
+            } else if (quote == '\0' && (*p == '"' || *p == '\'')) {
+                quote = *p++;
+            } else {
+                *q++ = *p++;
+            }
+        }
+
+        if (*p != '\0')
+            ++p;
+        *q = '\0';
+
+        if ((err = rsp_arg(ap, tok, depth)) < 0)
+            return err;
+    }
+
+    return 0;
+}
+
+/*
+ * Read a whole response file into a NUL
+ * terminated buffer.
+ */
+static char *
+rsp_read(const char *pathname)
+{
+    FILE *fp;
+    char *buf;
+    long size;
+
+    if ((fp = fopen(pathname, "r")) == NULL)
+        return NULL;
+
+    if (fseek(fp, 0, SEEK_END) < 0 || (size = ftell(fp)) < 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    rewind(fp);
+    if ((buf = malloc(size + 1)) == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+
+    size = fread(buf, 1, size, fp);
+    buf[size] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+/*
+ * Add one argument, expanding it if it
+ * names a response file.
+ */
+static int
+rsp_arg(struct rsp_args *ap, const char *arg, int depth)
+{
+    char *buf;
+    int err;
+
+    if (arg[0] != '@' || arg[1] == '\0')
+        return rsp_push(ap, arg);
+
+    if (depth >= LDO_RSP_MAXDEPTH) {
+        fprintf(stderr, "ldo: response files nested too deep at %s\n", arg);
+        return -ELOOP;
+    }
+
+    if ((buf = rsp_read(&arg[1])) == NULL) {
+        fprintf(stderr, "ldo: cannot read response file \"%s\"\n", &arg[1]);
+        return -ENOENT;
+    }
+
+    err = rsp_split(ap, buf, depth + 1);
+    free(buf);
+    return err;
+}
+
+/*
+ * Expand every @file argument into the arguments the
+ * file holds. If there are none, argv is handed back
+ * as is, otherwise the new vector must be released
+ * with ldo_rsp_free().
+ *
+ * @argc: Argument count.
+ * @argv: Argument vector.
+ * @argcp: Returns the new argument count.
+ * @argvp: Returns the new argument vector.
+ */
+int
+ldo_rsp_expand(int argc, char **argv, int *argcp, char ***argvp)
+{
+    struct rsp_args args = { NULL, 0, 0 };
+    int i, err = 0;
+
+    *argcp = argc;
+    *argvp = argv;
+
+    for (i = 1; i < argc; ++i) {
+        if (argv[i][0] == '@')
+            break;
+    }
+
+    if (i == argc)
+        return 0;
+
+    if ((err = rsp_push(&args, argv[0])) < 0)
+        goto fail;
+
+    for (i = 1; i < argc; ++i) {
+        if ((err = rsp_arg(&args, argv[i], 0)) < 0)
+            goto fail;
+    }
+
+    *argcp = args.n;
+    *argvp = args.v;
+    return 0;
+fail:
+    ldo_rsp_free(args.n, args.v, argv);
+    return err;
+}
+
+/*
+ * Release a vector from ldo_rsp_expand().
+ *
+ * @argc: Argument count.
+ * @argv: Expanded argument vector.
+ * @orig: Vector that was expanded.
+ */
+void
+ldo_rsp_free(int argc, char **argv, char **orig)
+{
+    int i;
+
+    if (argv == orig || argv == NULL)
+        return;
+
+    for (i = 0; i < argc; ++i) {
+        free(argv[i]);
+    }
+
+    free(argv);
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Link maps. -Map writes a map for people to read and
+ * --map-json one for tools, both list every output
+ * section with the input sections and static arrays
+ * that went into it. Maps are streamed out section by
+ * section through stdio as they are walked.
+ */
+
+#include <sys/errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/map.h>
+#include <ldo/merge.h>
+#include <ldo/sarry.h>
+#include <ldo/cdefs.h>
+
+/*
+ * Writes one kind of map.
+ */
+typedef void (*map_fn_t)(FILE *fp, const struct ldo_output *op,
+    struct sarry_objq *qp);
+
+/*
+ * Returns the pool a string pool section stands for.
+ */
+static inline const struct ldo_merge *
+map_pool(const struct ldo_isec *isp)
+{
+    return (const struct ldo_merge *)((const char *)isp -
+        offsetof(struct ldo_merge, isec));
+}
+
+/*
+ * Returns the combined size of the sections merged
+ * into a pool.
+ */
+static uint64_t
+map_pool_size(const struct ldo_merge *mp)
+{
+    uint64_t size = 0;
+    size_t i;
+
+    for (i = 0; i < mp->nin; ++i) {
+        size += mp->ins[i].isp->size;
+    }
+
+    return size;
+}
+
+/*
+ * Write the SHF_* flags of a section the way
+ * readelf shows them.
+ */
+static void
+map_flags(FILE *fp, Elf64_Xword flags)
+{
+    static const struct {
+        Elf64_Xword flag;
+        char c;
+    } tab[] = {
+        { SHF_WRITE,        'W' },
+        { SHF_ALLOC,        'A' },
+        { SHF_EXECINSTR,    'X' },
+        { SHF_MERGE,        'M' },
+        { SHF_STRINGS,      'S' },
+        { SHF_TLS,          'T' },
+        { SHF_COMPRESSED,   'C' },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(tab) / sizeof(tab[0]); ++i) {
+        if ((flags & tab[i].flag) != 0)
+            fputc(tab[i].c, fp);
+    }
+}
+
+/*
+ * Write a JSON string.
+ */
+static void
+map_jstr(FILE *fp, const char *s)
+{
+    unsigned char c;
+
+    fputc('"', fp);
+    while ((c = *s++) != '\0') {
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static void
+map_text_osec(FILE *fp, const struct ldo_osec *osp, struct sarry_objq *qp)
+{
+    const struct ldo_isec *isp;
+    const struct ldo_merge *mp;
+    struct sarry_obj *obj;
+    size_t i;
+
+    fprintf(fp, "\n%-24s 0x%016llx 0x%08llx 0x%08llx ", osp->name,
+        (unsigned long long)osp->addr, (unsigned long long)osp->offset,
+        (unsigned long long)osp->size);
+    map_flags(fp, osp->flags);
+    if (osp->real_size != 0)
+        fprintf(fp, " (0x%llx uncompressed)",
+            (unsigned long long)osp->real_size);
+    fputc('\n', fp);
+
+    for (i = 0; i < osp->nisec; ++i) {
+        isp = osp->isecs[i];
+        fprintf(fp, " %-23s 0x%016llx 0x%08llx 0x%08llx ", isp->name,
+            (unsigned long long)(osp->addr ? osp->addr + isp->off : 0),
+            (unsigned long long)isp->off, (unsigned long long)isp->size);
+
+        if ((isp->flags & LDO_ISEC_POOL) != 0) {
+            mp = map_pool(isp);
+            fprintf(fp, "<%zu sections merged from 0x%llx>\n", mp->nin,
+                (unsigned long long)map_pool_size(mp));
+            continue;
+        }
+
+        fputs(isp->in->pathname, fp);
+        if (isp->zsize != 0)
+            fprintf(fp, " (0x%zx compressed)", isp->zsize);
+        fputc('\n', fp);
+    }
+
+    if (osp->nisec != 0 || strcmp(osp->name, SARRY_SECTION) != 0)
+        return;
+
+    for (i = 0; i < qp->next; ++i) {
+        if ((obj = sarry_objq_get(qp, i)) == NULL || obj->off == 0)
+            continue;
+        fprintf(fp, " %-23s 0x%016llx 0x%08llx 0x%08llx %s "
+            "(0x%zx uncompressed)\n", obj->name,
+            (unsigned long long)(osp->addr + obj->off),
+            (unsigned long long)obj->off, (unsigned long long)obj->size,
+            obj->pathname, obj->real_size);
+    }
+}
+
+/*
+ * Write the map for people to read.
+ */
+static void
+map_text(FILE *fp, const struct ldo_output *op, struct sarry_objq *qp)
+{
+    size_t i;
+
+    fprintf(fp, "Link map of %s\n\n", op->pathname);
+    fprintf(fp, "%-24s %-18s %-10s %-10s %s\n", "Section", "Address",
+        "Offset", "Size", "Flags/Input");
+
+    for (i = 0; i < op->nosec; ++i) {
+        map_text_osec(fp, &op->osecs[i], qp);
+    }
+}
+
+static void
+map_json_osec(FILE *fp, const struct ldo_osec *osp, struct sarry_objq *qp)
+{
+    const struct ldo_isec *isp;
+    const struct ldo_merge *mp;
+    struct sarry_obj *obj;
+    const char *sep = "";
+    size_t i;
+
+    fputs("{\"name\":", fp);
+    map_jstr(fp, osp->name);
+    fprintf(fp, ",\"type\":%u,\"flags\":\"", osp->type);
+    map_flags(fp, osp->flags);
+    fprintf(fp, "\",\"addr\":%llu,\"offset\":%llu,\"size\":%llu,"
+        "\"real_size\":%llu,\"align\":%llu,\"inputs\":[",
+        (unsigned long long)osp->addr, (unsigned long long)osp->offset,
+        (unsigned long long)osp->size,
+        (unsigned long long)(osp->real_size ? osp->real_size : osp->size),
+        (unsigned long long)osp->align);
+
+    for (i = 0; i < osp->nisec; ++i) {
+        isp = osp->isecs[i];
+        fprintf(fp, "%s\n  {\"section\":", sep);
+        map_jstr(fp, isp->name);
+        fprintf(fp, ",\"offset\":%llu,\"size\":%llu,",
+            (unsigned long long)isp->off, (unsigned long long)isp->size);
+
+        if ((isp->flags & LDO_ISEC_POOL) != 0) {
+            mp = map_pool(isp);
+            fprintf(fp, "\"merged\":%zu,\"merged_size\":%llu}", mp->nin,
+                (unsigned long long)map_pool_size(mp));
+        } else {
+            fputs("\"file\":", fp);
+            map_jstr(fp, isp->in->pathname);
+            fprintf(fp, ",\"stored_size\":%zu}",
+                isp->zsize ? isp->zsize : isp->size);
+        }
+        sep = ",";
+    }
+
+    fputs("],\"arrays\":[", fp);
+    sep = "";
+    if (osp->nisec != 0 || strcmp(osp->name, SARRY_SECTION) != 0)
+        qp = NULL;
+
+    for (i = 0; qp != NULL && i < qp->next; ++i) {
+        if ((obj = sarry_objq_get(qp, i)) == NULL || obj->off == 0)
+            continue;
+
+        fprintf(fp, "%s\n  {\"name\":", sep);
+        map_jstr(fp, obj->name);
+        fputs(",\"file\":", fp);
+        map_jstr(fp, obj->pathname);
+        fprintf(fp, ",\"offset\":%llu,\"size\":%zu,\"real_size\":%zu,"
+            "\"blocks\":%zu}", (unsigned long long)obj->off, obj->size,
+            obj->real_size, obj->nblock);
+        sep = ",";
+    }
+
+    fputs("]}", fp);
+}
+
+/*
+ * Write the map for tools.
+ */
+static void
+map_json(FILE *fp, const struct ldo_output *op, struct sarry_objq *qp)
+{
+    size_t i;
+
+    fputs("{\"output\":", fp);
+    map_jstr(fp, op->pathname);
+    fprintf(fp, ",\"size\":%zu,\"sections\":[\n", op->size);
+
+    for (i = 0; i < op->nosec; ++i) {
+        if (i != 0)
+            fputs(",\n", fp);
+        map_json_osec(fp, &op->osecs[i], qp);
+    }
+
+    fputs("\n]}\n", fp);
+}
+
+static int
+map_open_write(const char *path, const struct ldo_output *op,
+    struct sarry_objq *qp, map_fn_t fn)
+{
+    FILE *fp;
+    int err;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+        fprintf(stderr, "ldo: cannot create map \"%s\"\n", path);
+        perror("fopen");
+        return -EIO;
+    }
+
+    fn(fp, op, qp);
+    err = ferror(fp);
+    if (fclose(fp) != 0 || err != 0) {
+        fprintf(stderr, "ldo: cannot write map \"%s\"\n", path);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/*
+ * Write the link maps that were asked for, once
+ * the output is laid out.
+ *
+ * @op: Output image.
+ * @qp: Static arrays packed into .static_array.
+ */
+int
+ldo_map_write(const struct ldo_output *op, struct sarry_objq *qp)
+{
+    const struct ldo_opts *opts = ldo_rtopts();
+    int err;
+
+    if (opts->map_path != NULL &&
+        (err = map_open_write(opts->map_path, op, qp, map_text)) < 0)
+        return err;
+    if (opts->map_json_path != NULL &&
+        (err = map_open_write(opts->map_json_path, op, qp, map_json)) < 0)
+        return err;
+
+    return 0;
+}
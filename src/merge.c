@@ -0,0 +1,562 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * String merging. Every SHF_MERGE|SHF_STRINGS input
+ * section is cut into its strings, which are hashed
+ * and put through a lock free string set, one input
+ * section per work item. The strings left over are
+ * written as a single pool that takes the place of
+ * those sections in their output section. With
+ * --tail-merge-strings a string that ends another
+ * one is folded into it as well.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/merge.h>
+#include <ldo/compress.h>
+#include <ldo/hash.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+
+#define ALIGNUP(X, A) (((X) + (A) - 1) & ~((uint64_t)(A) - 1))
+
+/* Largest character size that is merged */
+#define MERGE_MAXENT 4
+
+/*
+ * Returns true if an input section can be merged.
+ */
+static int
+merge_wanted(const struct ldo_isec *isp)
+{
+    const Elf64_Shdr *shdr = isp->shdr;
+    const Elf64_Xword want = SHF_MERGE | SHF_STRINGS;
+    uint64_t ent = shdr->sh_entsize;
+
+    if ((shdr->sh_flags & want) != want)
+        return 0;
+    if (shdr->sh_type != SHT_PROGBITS || isp->data == NULL)
+        return 0;
+    if (ent == 0 || ent > MERGE_MAXENT || (ent & (ent - 1)) != 0)
+        return 0;
+
+    return isp->size != 0 && isp->size % ent == 0;
+}
+
+static inline int
+merge_isnul(const char *p, size_t ent)
+{
+    size_t i;
+
+    for (i = 0; i < ent; ++i) {
+        if (p[i] != '\0')
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Returns the offset just past the terminator of
+ * the string at `off'. The section is known to end
+ * with a terminator.
+ */
+static size_t
+merge_next(const char *data, size_t off, size_t size, size_t ent)
+{
+    if (ent == 1)
+        return (const char *)memchr(data + off, '\0', size - off) - data + 1;
+
+    while (!merge_isnul(data + off, ent))
+        off += ent;
+    return off + ent;
+}
+
+static inline int
+merge_eq(const struct ldo_piece *a, const struct ldo_piece *b)
+{
+    if (a->hash != b->hash || a->len != b->len)
+        return 0;
+
+    return memcmp(a->str, b->str, a->len) == 0;
+}
+
+/*
+ * Inflate a section if need be and count its
+ * strings, runs on the worker pool.
+ */
+static void
+merge_load(size_t idx, void *arg)
+{
+    struct ldo_merge *mp = arg;
+    struct ldo_mergein *mi = &mp->ins[idx];
+    struct ldo_isec *isp = mi->isp;
+    size_t off = 0, n = 0;
+    int err;
+
+    mi->data = isp->data;
+    if (isp->zsize != 0) {
+        if ((mi->buf = malloc(isp->size)) == NULL) {
+            __atomic_store_n(&mp->err, -ENOMEM, __ATOMIC_RELAXED);
+            return;
+        }
+        if ((err = ldo_isec_copy(isp, mi->buf)) < 0) {
+            __atomic_store_n(&mp->err, err, __ATOMIC_RELAXED);
+            return;
+        }
+        mi->data = mi->buf;
+    }
+
+    if (!merge_isnul(mi->data + isp->size - mp->entsize, mp->entsize)) {
+        fprintf(stderr, "ldo: %s: %s: string is not null terminated\n",
+            isp->in->pathname, isp->name);
+        __atomic_store_n(&mp->err, -ENOEXEC, __ATOMIC_RELAXED);
+        return;
+    }
+
+    while (off < isp->size) {
+        off = merge_next(mi->data, off, isp->size, mp->entsize);
+        ++n;
+    }
+
+    mi->npiece = n;
+}
+
+/*
+ * Add a string to the set. Whichever string comes
+ * first in command line order ends up owning its
+ * slot, however the threads race, which keeps the
+ * output the same from one link to the next.
+ */
+static void
+merge_insert(struct ldo_merge *mp, size_t id)
+{
+    struct ldo_piece *pp = &mp->pieces[id];
+    uint64_t cur, want = id + 1;
+    size_t i;
+
+    for (i = pp->hash & mp->mask;; i = (i + 1) & mp->mask) {
+        cur = __atomic_load_n(&mp->slots[i], __ATOMIC_ACQUIRE);
+        if (cur == 0 && __atomic_compare_exchange_n(&mp->slots[i], &cur,
+            want, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            break;
+
+        /* `cur' is whoever holds the slot now */
+        if (!merge_eq(&mp->pieces[cur - 1], pp))
+            continue;
+
+        while (cur > want && !__atomic_compare_exchange_n(&mp->slots[i],
+            &cur, want, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            ;
+        break;
+    }
+
+    pp->slot = i;
+}
+
+/*
+ * Cut a section into strings, hash them and add
+ * them to the set, runs on the worker pool.
+ */
+static void
+merge_split(size_t idx, void *arg)
+{
+    struct ldo_merge *mp = arg;
+    struct ldo_mergein *mi = &mp->ins[idx];
+    struct ldo_piece *pp;
+    size_t i, off = 0, end;
+
+    for (i = 0; i < mi->npiece; ++i) {
+        pp = &mp->pieces[mi->base + i];
+        end = merge_next(mi->data, off, mi->isp->size, mp->entsize);
+        pp->str = mi->data + off;
+        pp->len = end - off;
+        pp->hash = ldo_hash64(pp->str, pp->len, 0);
+        merge_insert(mp, mi->base + i);
+        off = end;
+    }
+}
+
+/*
+ * Copy the strings a section owns into the pool,
+ * runs on the worker pool.
+ */
+static void
+merge_copy(size_t idx, void *arg)
+{
+    struct ldo_merge *mp = arg;
+    struct ldo_mergein *mi = &mp->ins[idx];
+    struct ldo_piece *pp;
+    size_t i;
+
+    for (i = 0; i < mi->npiece; ++i) {
+        pp = &mp->pieces[mi->base + i];
+        if (pp->owner)
+            memcpy(mp->pool + pp->out, pp->str, pp->len);
+    }
+}
+
+/*
+ * Order strings by their reversed contents, longest
+ * first among those that share an ending. A string
+ * then follows the ones it is a tail of.
+ */
+static int
+merge_rcmp(const void *a, const void *b)
+{
+    const struct ldo_piece *pa = *(struct ldo_piece *const *)a;
+    const struct ldo_piece *pb = *(struct ldo_piece *const *)b;
+    const unsigned char *sa = (const unsigned char *)pa->str + pa->len;
+    const unsigned char *sb = (const unsigned char *)pb->str + pb->len;
+    size_t i, n = (pa->len < pb->len) ? pa->len : pb->len;
+
+    for (i = 1; i <= n; ++i) {
+        if (sa[-i] != sb[-i])
+            return (sa[-i] < sb[-i]) ? 1 : -1;
+    }
+
+    return (pa->len < pb->len) - (pa->len > pb->len);
+}
+
+/*
+ * Give every unique string its place in the pool,
+ * returns the size of the pool. Strings are placed
+ * in command line order, or in tail order when tail
+ * merging.
+ */
+static ssize_t
+merge_place(struct ldo_merge *mp, int tail)
+{
+    struct ldo_piece *pp, *prev = NULL, **sorted = NULL;
+    uint64_t off = 0, align = 1;
+    size_t i, owner, n = 0;
+
+    /* Each string keeps the alignment of its section */
+    if (mp->isec.align > mp->entsize)
+        align = mp->isec.align;
+    if (align > 1)
+        tail = 0;
+
+    if (tail && (sorted = malloc(mp->npiece * sizeof(*sorted))) == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < mp->npiece; ++i) {
+        pp = &mp->pieces[i];
+        owner = mp->slots[pp->slot] - 1;
+        pp->owner = (owner == i);
+        if (!pp->owner) {
+            pp->out = mp->pieces[owner].out;
+            continue;
+        }
+
+        if (tail) {
+            sorted[n++] = pp;
+            continue;
+        }
+
+        off = ALIGNUP(off, align);
+        pp->out = off;
+        off += pp->len;
+    }
+
+    if (!tail)
+        return off;
+
+    qsort(sorted, n, sizeof(*sorted), merge_rcmp);
+    for (i = 0; i < n; ++i) {
+        pp = sorted[i];
+        if (prev != NULL && prev->len >= pp->len &&
+            memcmp(prev->str + prev->len - pp->len, pp->str, pp->len) == 0) {
+            pp->out = prev->out + prev->len - pp->len;
+            pp->owner = 0;
+            continue;
+        }
+
+        pp->out = off;
+        off += pp->len;
+        prev = pp;
+    }
+
+    /* Copies took their offset before their owner had one */
+    for (i = 0; i < mp->npiece; ++i) {
+        pp = &mp->pieces[i];
+        if (mp->slots[pp->slot] - 1 != i)
+            pp->out = mp->pieces[mp->slots[pp->slot] - 1].out;
+    }
+
+    free(sorted);
+    return off;
+}
+
+/*
+ * Merge the strings of one pool.
+ */
+static int
+merge_run(struct ldo_merge *mp, int tail)
+{
+    size_t i, nslot = 16, before = 0;
+    ssize_t size;
+
+    ldo_parallel_for(mp->nin, merge_load, mp);
+    if (mp->err < 0)
+        return mp->err;
+
+    for (i = 0; i < mp->nin; ++i) {
+        mp->ins[i].base = mp->npiece;
+        mp->npiece += mp->ins[i].npiece;
+        before += mp->ins[i].isp->size;
+    }
+
+    while (nslot < mp->npiece * 2)
+        nslot <<= 1;
+
+    mp->mask = nslot - 1;
+    mp->slots = calloc(nslot, sizeof(*mp->slots));
+    mp->pieces = calloc(mp->npiece, sizeof(*mp->pieces));
+    if (mp->slots == NULL || mp->pieces == NULL)
+        return -ENOMEM;
+
+    ldo_parallel_for(mp->nin, merge_split, mp);
+    if ((size = merge_place(mp, tail)) < 0)
+        return size;
+
+    free(mp->slots);
+    mp->slots = NULL;
+
+    if ((mp->pool = calloc(1, size + 1)) == NULL)
+        return -ENOMEM;
+
+    ldo_parallel_for(mp->nin, merge_copy, mp);
+    mp->isec.data = mp->pool;
+    mp->isec.size = size;
+
+    vlog("merge: %s: %zu strings, %zu -> %zu bytes\n", mp->isec.name,
+        mp->npiece, before, (size_t)size);
+    return 0;
+}
+
+/*
+ * Start a pool for the input sections of an
+ * output section that merge like `isp'.
+ */
+static struct ldo_merge *
+merge_new(struct ldo_osec *osp, struct ldo_isec *isp)
+{
+    struct ldo_merge *mp;
+
+    if ((mp = calloc(1, sizeof(*mp))) == NULL)
+        return NULL;
+    if ((mp->ins = calloc(osp->nisec, sizeof(*mp->ins))) == NULL) {
+        free(mp);
+        return NULL;
+    }
+
+    mp->entsize = isp->shdr->sh_entsize;
+    mp->isec.in = isp->in;
+    mp->isec.shdr = isp->shdr;
+    mp->isec.name = isp->name;
+    mp->isec.align = isp->align;
+    mp->isec.flags = LDO_ISEC_POOL;
+    mp->isec.repl = &mp->isec;
+    mp->isec.icf_idx = LDO_NOIDX;
+    mp->isec.order = LDO_NOIDX;
+    return mp;
+}
+
+/*
+ * Sort the mergeable input sections of an output
+ * section into pools, by entry size and alignment.
+ */
+static int
+merge_group(struct ldo_osec *osp, struct ldo_mergeq *mq)
+{
+    struct ldo_merge *mp, *first = NULL;
+    struct ldo_mergein *mi;
+    struct ldo_isec *isp;
+    size_t i;
+
+    for (i = 0; i < osp->nisec; ++i) {
+        isp = osp->isecs[i];
+        if (!merge_wanted(isp))
+            continue;
+
+        mp = first;
+        while (mp != NULL) {
+            if (mp->entsize == isp->shdr->sh_entsize &&
+                mp->isec.align == isp->align)
+                break;
+            mp = TAILQ_NEXT(mp, link);
+        }
+
+        if (mp == NULL) {
+            if ((mp = merge_new(osp, isp)) == NULL)
+                return -ENOMEM;
+            TAILQ_INSERT_TAIL(mq, mp, link);
+            if (first == NULL)
+                first = mp;
+        }
+
+        mi = &mp->ins[mp->nin++];
+        mi->isp = isp;
+        mi->mp = mp;
+        isp->merge = mi;
+    }
+
+    return 0;
+}
+
+/*
+ * Put each pool in its output section, where its
+ * first input section was, in place of all of them.
+ */
+static size_t
+merge_replace(struct ldo_osec *osp)
+{
+    struct ldo_isec *isp;
+    size_t i, n = 0;
+
+    for (i = 0; i < osp->nisec; ++i) {
+        isp = osp->isecs[i];
+        if (isp->merge == NULL) {
+            osp->isecs[n++] = isp;
+            continue;
+        }
+
+        if (isp->merge == &isp->merge->mp->ins[0])
+            osp->isecs[n++] = &isp->merge->mp->isec;
+    }
+
+    i = osp->nisec - n;
+    osp->nisec = n;
+    return i;
+}
+
+/*
+ * Merge the strings of every SHF_MERGE|SHF_STRINGS
+ * input section, called once input sections are
+ * grouped but before they are laid out. The pools
+ * go on `mq' and must outlive the output.
+ *
+ * @op: Output image.
+ * @mq: Queue to put the pools on.
+ */
+int
+ldo_merge_strings(struct ldo_output *op, struct ldo_mergeq *mq)
+{
+    struct ldo_merge *mp;
+    int tail = (ldo_rtflags() & LDO_F_TAIL_MERGE) != 0;
+    size_t i;
+    int err;
+
+    for (i = 0; i < op->nosec; ++i) {
+        if ((err = merge_group(&op->osecs[i], mq)) < 0)
+            goto fail;
+    }
+
+    TAILQ_FOREACH(mp, mq, link) {
+        if ((err = merge_run(mp, tail)) < 0)
+            goto fail;
+    }
+
+    for (i = 0; i < op->nosec; ++i) {
+        op->nisec -= merge_replace(&op->osecs[i]);
+    }
+
+    return 0;
+fail:
+    if (err == -ENOMEM)
+        fprintf(stderr, "ldo_merge_strings: out of memory\n");
+    return err;
+}
+
+/*
+ * Find where a byte of a merged input section
+ * ended up, once the output is laid out.
+ *
+ * @isp: Input section.
+ * @off: Offset within `isp'.
+ * @resp: Set to the offset within its output section.
+ */
+int
+ldo_merge_offset(const struct ldo_isec *isp, uint64_t off, uint64_t *resp)
+{
+    const struct ldo_mergein *mi = isp->merge;
+    const struct ldo_piece *pp;
+    size_t lo, hi, mid;
+
+    if (mi == NULL || off >= isp->size)
+        return -ENOENT;
+
+    /* Last string starting at or before `off' */
+    lo = 0;
+    hi = mi->npiece;
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if ((uint64_t)(mi->mp->pieces[mi->base + mid].str - mi->data) <= off)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    pp = &mi->mp->pieces[mi->base + lo];
+    *resp = mi->mp->isec.off + pp->out + (off - (pp->str - mi->data));
+    return 0;
+}
+
+/*
+ * Free every pool on a queue.
+ *
+ * @mq: Queue of pools.
+ */
+void
+ldo_merge_free(struct ldo_mergeq *mq)
+{
+    struct ldo_merge *mp;
+    size_t i;
+
+    while ((mp = TAILQ_FIRST(mq)) != NULL) {
+        TAILQ_REMOVE(mq, mp, link);
+        for (i = 0; i < mp->nin; ++i) {
+            mp->ins[i].isp->merge = NULL;
+            free(mp->ins[i].buf);
+        }
+
+        free(mp->ins);
+        free(mp->pieces);
+        free(mp->slots);
+        free(mp->pool);
+        free(mp);
+    }
+}
@@ -27,93 +27,129 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <sys/queue.h>
 #include <sys/errno.h>
 #include <ldo/object.h>
 #include <ldo/cdefs.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
 
 /*
- * Checks if an object is in the static array
- * queue and returns it if so, otherwise NULL
- * will be returned.
+ * Find the slot for an index.
  *
- * @qp: Queue to check.
- * @op: Object to look for.
+ * Segment n starts at index cap * (2^n - 1), so
+ * the segment is the log2 of (idx / cap + 1).
+ *
+ * @qp: Queue to look in.
+ * @idx: Index of the slot.
+ * @segp: Returns the segment.
  */
-static struct sarry_obj *
-sarry_obj(struct sarry_objq *qp, struct sarry_obj *op)
+static size_t
+sarry_slot(const struct sarry_objq *qp, size_t idx, size_t *segp)
 {
-    struct sarry_obj *tmp;
+    size_t seg, q;
 
-    TAILQ_FOREACH(tmp, &qp->q, link) {
-        if (tmp == op) {
-            return tmp;
-        }
-    }
-
-    return NULL;
+    q = idx / qp->cap + 1;
+    seg = (sizeof(q) * 8 - 1) - __builtin_clzl(q);
+    *segp = seg;
+    return idx - qp->cap * ((1UL << seg) - 1);
 }
 
 /*
  * Initialize an object queue.
  *
  * @qp: Object queue pointer.
- * @cap: Capacity
- *
- * XXX: `cap' must be a power-of-two and must not exceed
- *      OBJQ_MAXCAP.
+ * @cap: Capacity of the first segment, rounded
+ *       up to a power-of-two and clamped to
+ *       OBJQ_MAXCAP.
  */
 int
 sarry_init_objq(struct sarry_objq *qp, size_t cap)
 {
-    uint8_t e;
+    memset(qp, 0, sizeof(*qp));
+    pthread_mutex_init(&qp->lock, NULL);
 
     /*
      * Power-of-two sizes are good for block
      * based processing
      */
-    if ((OBJQ_MAXCAP & 1) != 0) {
-        fprintf(stderr, "OBJQ_MAXCAP is not a power of two\n");
-        return -EINVAL;
-    }
+    if (cap > OBJQ_MAXCAP)
+        cap = OBJQ_MAXCAP;
+
+    qp->cap = 1;
+    while (qp->cap < cap)
+        qp->cap <<= 1;
 
-    /* Ensure `cap' doesn't exceed the limit */
-    if (cap > OBJQ_MAXCAP) {
-        e = log2(OBJQ_MAXCAP);
-        fprintf(stderr, "cap exceeds OBJQ_MAXCAP, rejecting...\n");
-        fprintf(stderr, "cap must be <= 2^%d (%d) entries\n", e, cap);
-        return -EINVAL;
+    qp->segs[0] = calloc(qp->cap, sizeof(struct sarry_obj));
+    if (qp->segs[0] == NULL) {
+        fprintf(stderr, "sarry_init_objq: out of memory\n");
+        return -ENOMEM;
     }
 
-    TAILQ_INIT(&qp->q);
-    qp->count = 0;
-    qp->cap = cap;
+    qp->nseg = 1;
+    return 0;
 }
 
 /*
- * Insert an object into an object queue.
+ * Insert an object into an object queue. The
+ * object is copied in and the returned pointer
+ * stays valid until the queue is flushed.
  *
  * @qp: Object queue pointer.
  * @op: Object pointer.
  */
-int
-sarry_objq_in(struct sarry_objq *qp, struct sarry_obj *op)
+struct sarry_obj *
+sarry_objq_in(struct sarry_objq *qp, const struct sarry_obj *op)
 {
-    size_t new_count;
+    struct sarry_obj *obj = NULL;
+    size_t seg, slot;
+
+    pthread_mutex_lock(&qp->lock);
+    slot = sarry_slot(qp, qp->next, &seg);
+
+    if (seg == qp->nseg) {
+        if (__unlikely(seg == OBJQ_NSEG)) {
+            fprintf(stderr, "sarry_objq_in: object queue full\n");
+            goto done;
+        }
 
-    new_count = (qp->count + 1);
-    if (new_count > OBJQ_MAXCAP) {
-        fprintf(stderr, "sarry_insert: object queue full\n");
-        return -ENOSPC;
+        qp->segs[seg] = calloc(qp->cap << seg, sizeof(*obj));
+        if (qp->segs[seg] == NULL) {
+            fprintf(stderr, "sarry_objq_in: out of memory\n");
+            goto done;
+        }
+        ++qp->nseg;
     }
 
-    TAILQ_INSERT_TAIL(&qp->q, op, link);
+    obj = &qp->segs[seg][slot];
+    *obj = *op;
+    ++qp->next;
     ++qp->count;
-    return 0;
+done:
+    pthread_mutex_unlock(&qp->lock);
+    return obj;
+}
+
+/*
+ * Get the object at an index, or NULL if there is
+ * none or it has been flushed.
+ *
+ * @qp: Object queue pointer.
+ * @idx: Index, in insertion order.
+ */
+struct sarry_obj *
+sarry_objq_get(struct sarry_objq *qp, size_t idx)
+{
+    struct sarry_obj *obj;
+    size_t seg, slot;
+
+    if (idx >= qp->next)
+        return NULL;
+
+    slot = sarry_slot(qp, idx, &seg);
+    obj = &qp->segs[seg][slot];
+    return (obj->pathname != NULL) ? obj : NULL;
 }
 
 /*
@@ -125,39 +161,33 @@ sarry_objq_in(struct sarry_objq *qp, struct sarry_obj *op)
 int
 sarry_objq_flush(struct sarry_objq *qp, struct sarry_obj *op)
 {
-    struct sarry_obj *obj;
-    struct sarry_obj *tmp;
-
-    /*
-     * If the object we are trying to remove is not
-     * found in the queue, something went poorly. This
-     * happening might even imply ldo is in an undefined
-     * state from this point out, however, just warn the
-     * user and see what happens as this should not throw
-     * anything _completly_ off...
-     */
-    tmp = sarry_obj(qp, op);
-    if (__unlikely(op != NULL && tmp == NULL)) {
-        fprintf(stdout, "[warn] sarry_objq_flush: 'op' not in 'qp'\n");
-        return -EIO;
-    }
+    size_t i;
 
     /*
      * Do we have a specific object we want to remove?
-     * If so, then that's all the work that needs to
-     * be done.
+     * If so, then just free its slot. Slots are never
+     * reused so indices stay stable.
      */
     if (op != NULL) {
-        TAILQ_REMOVE(&qp->q, op, link);
+        if (__unlikely(op->pathname == NULL)) {
+            fprintf(stdout, "[warn] sarry_objq_flush: 'op' not in 'qp'\n");
+            return -EIO;
+        }
+
+        op->pathname = NULL;
+        op->cdata = NULL;
+        op->blocks = NULL;
+        --qp->count;
         return 0;
     }
 
-    while (!TAILQ_EMPTY(&qp->q)) {
-        /* Pop object off the queue */
-        obj = TAILQ_FIRST(&qp->q);
-        TAILQ_REMOVE(&qp->q, obj, link);
-        free(obj);
+    for (i = 0; i < qp->nseg; ++i) {
+        free(qp->segs[i]);
+        qp->segs[i] = NULL;
     }
 
+    qp->nseg = 0;
+    qp->next = 0;
+    qp->count = 0;
     return 0;
 }
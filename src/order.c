@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Symbol ordering files. An ordering file lists one symbol
+ * per line, hottest first, as produced from a profile. The
+ * section defining each listed symbol is placed at the start
+ * of its output section in that order so hot code ends up
+ * packed together. Blank lines and lines starting with '#'
+ * are ignored.
+ */
+
+#include <sys/errno.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/order.h>
+#include <ldo/hash.h>
+#include <ldo/thread.h>
+
+/*
+ * A symbol listed in the ordering file.
+ *
+ * @name: Symbol name (NULL if the slot is free).
+ * @rank: Line of the symbol, counting from zero.
+ * @found: Set once a definition has been seen.
+ */
+struct order_slot {
+    const char *name;
+    uint32_t rank;
+    uint8_t found;
+};
+
+/*
+ * Loaded ordering file.
+ *
+ * @buf: File contents, names point in here.
+ * @slots: Open addressed table of symbols.
+ * @nslots: Number of slots (a power-of-two).
+ * @count: Number of symbols.
+ */
+static struct {
+    char *buf;
+    struct order_slot *slots;
+    size_t nslots;
+    size_t count;
+} order;
+
+static struct order_slot *
+order_lookup(const char *name)
+{
+    size_t mask = order.nslots - 1;
+    size_t i;
+
+    i = ldo_hash64(name, strlen(name), 0) & mask;
+    while (order.slots[i].name != NULL) {
+        if (strcmp(order.slots[i].name, name) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &order.slots[i];
+}
+
+/*
+ * Read the file into a NUL terminated buffer and
+ * split it into lines in place. Returns the number
+ * of lines.
+ */
+static size_t
+order_read(FILE *fp)
+{
+    size_t size = 0, cap = 0, n, nlines = 0, i;
+    char *tmp;
+
+    for (;;) {
+        if (size + 4096 + 1 > cap) {
+            cap = cap ? cap * 2 : 65536;
+            if ((tmp = realloc(order.buf, cap)) == NULL)
+                return 0;
+            order.buf = tmp;
+        }
+
+        if ((n = fread(order.buf + size, 1, cap - size - 1, fp)) == 0)
+            break;
+        size += n;
+    }
+
+    if (order.buf == NULL)
+        return 0;
+
+    order.buf[size] = '\0';
+    for (i = 0; i < size; ++i) {
+        if (order.buf[i] == '\n') {
+            order.buf[i] = '\0';
+            ++nlines;
+        }
+    }
+
+    return nlines + 1;
+}
+
+/*
+ * Load a symbol ordering file.
+ *
+ * @path: Ordering file.
+ */
+int
+ldo_order_load(const char *path)
+{
+    struct order_slot *sp;
+    FILE *fp;
+    char *p, *end, *line;
+    size_t nlines;
+
+    ldo_order_free();
+    if ((fp = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "ldo_order_load: cannot open \"%s\"\n", path);
+        return -ENOENT;
+    }
+
+    nlines = order_read(fp);
+    fclose(fp);
+
+    order.nslots = 16;
+    while (order.nslots < nlines * 2)
+        order.nslots <<= 1;
+
+    order.slots = calloc(order.nslots, sizeof(*order.slots));
+    if (order.buf == NULL || order.slots == NULL) {
+        fprintf(stderr, "ldo_order_load: out of memory\n");
+        ldo_order_free();
+        return -ENOMEM;
+    }
+
+    for (line = order.buf; nlines-- > 0; line += strlen(line) + 1) {
+        p = line;
+        while (isspace((unsigned char)*p))
+            ++p;
+
+        end = p + strlen(p);
+        while (end > p && isspace((unsigned char)end[-1]))
+            *--end = '\0';
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        /* The first mention of a symbol wins */
+        sp = order_lookup(p);
+        if (sp->name != NULL)
+            continue;
+
+        sp->name = p;
+        sp->rank = order.count++;
+    }
+
+    vlog("order: %zu symbols from %s\n", order.count, path);
+    return 0;
+}
+
+/*
+ * Lower the order of a section to `rank' if it is
+ * not ordered earlier already. Sections can be
+ * reached from more than one input at once through
+ * ICF, so this is an atomic min.
+ */
+static void
+order_set(struct ldo_isec *isp, uint32_t rank)
+{
+    uint32_t cur = __atomic_load_n(&isp->order, __ATOMIC_RELAXED);
+
+    while (rank < cur) {
+        if (__atomic_compare_exchange_n(&isp->order, &cur, rank, 0,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+}
+
+/*
+ * Order the sections of one input, runs on the
+ * worker pool.
+ */
+static void
+order_work(size_t idx, void *arg)
+{
+    struct ldo_input **ins = arg;
+    struct ldo_input *in = ins[idx];
+    const Elf64_Sym *sym;
+    struct order_slot *sp;
+    struct ldo_isec *isp;
+    const char *name;
+    size_t i;
+
+    for (i = 1; i < in->nsym; ++i) {
+        sym = &in->syms[i];
+        if (ELF64_ST_TYPE(sym->st_info) == STT_SECTION)
+            continue;
+        if ((isp = ldo_input_symsec(in, i)) == NULL)
+            continue;
+
+        name = ldo_input_symname(in, i);
+        if (*name == '\0')
+            continue;
+
+        sp = order_lookup(name);
+        if (sp->name == NULL)
+            continue;
+
+        /* A folded section lives on as its replacement */
+        order_set(isp->repl, sp->rank);
+        __atomic_store_n(&sp->found, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Give every section that defines a listed symbol
+ * its position in the ordering file.
+ *
+ * @iq: Every input of this link.
+ */
+void
+ldo_order_apply(struct ldo_inputq *iq)
+{
+    struct ldo_input **ins, *in;
+    size_t i, n = 0, missing = 0;
+
+    if (order.slots == NULL)
+        return;
+
+    if ((ins = calloc(iq->count + 1, sizeof(*ins))) == NULL)
+        return;
+
+    TAILQ_FOREACH(in, &iq->q, link) {
+        ins[n++] = in;
+    }
+
+    ldo_parallel_for(n, order_work, ins);
+    free(ins);
+
+    for (i = 0; i < order.nslots; ++i) {
+        if (order.slots[i].name == NULL || order.slots[i].found)
+            continue;
+        vlog("order: %s not defined\n", order.slots[i].name);
+        ++missing;
+    }
+
+    if (missing != 0) {
+        fprintf(stdout, "[warn] ldo_order_apply: %zu symbols in the "
+            "ordering file not found\n", missing);
+    }
+}
+
+void
+ldo_order_free(void)
+{
+    free(order.buf);
+    free(order.slots);
+    memset(&order, 0, sizeof(order));
+}
@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Output image writer. Once the layout engine has placed
+ * every input section, the image is mapped and every input
+ * section is copied into place in parallel.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <ldo/ldo.h>
+#include <ldo/output.h>
+#include <ldo/layout.h>
+#include <ldo/buildid.h>
+#include <ldo/thread.h>
+#include <ldo/bswap.h>
+#include <ldo/object.h>
+#include <ldo/sarry.h>
+#include <ldo/compress.h>
+#include <ldo/debuglink.h>
+#include <ldo/merge.h>
+#include <ldo/map.h>
+#include <ldo/relax.h>
+#include <ldo/cdefs.h>
+
+/*
+ * Build ID note as it appears in the image.
+ */
+struct bid_note {
+    Elf64_Nhdr nhdr;
+    char name[4];
+    uint8_t desc[LDO_BUILDID_SIZE];
+};
+
+/*
+ * Copy a single input section into the image,
+ * compressed sections are inflated in place and
+ * GOT references relaxed.
+ */
+static void
+out_copy_work(size_t idx, void *arg)
+{
+    struct ldo_output *op = arg;
+    struct ldo_isec *isp = op->isecs[idx];
+    char *dst;
+    int err;
+
+    if (isp->data == NULL || isp->osec->type == SHT_NOBITS)
+        return;
+
+    /* Contents were replaced as a whole, e.g. compressed */
+    if (isp->osec->data != NULL)
+        return;
+
+    dst = op->map + isp->osec->offset + isp->off;
+    if ((err = ldo_isec_copy(isp, dst)) < 0) {
+        __atomic_store_n(&op->err, err, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (op->relax != NULL)
+        ldo_relax_isec(op->relax, isp, dst);
+}
+
+/*
+ * Write the ELF header, program headers and section
+ * header table in the byte order of the first input.
+ */
+void
+ldo_output_headers(struct ldo_output *op, const struct ldo_input *first,
+    size_t shstrndx)
+{
+    Elf64_Ehdr *eh = (Elf64_Ehdr *)op->map;
+    Elf64_Phdr *phdr;
+    Elf64_Shdr *shdr;
+    struct ldo_osec *osp;
+    size_t i;
+
+    memcpy(eh->e_ident, first->eh->e_ident, EI_NIDENT);
+    eh->e_type = ET_EXEC;
+    eh->e_machine = first->eh->e_machine;
+    eh->e_version = EV_CURRENT;
+    eh->e_flags = first->eh->e_flags;
+    eh->e_ehsize = sizeof(Elf64_Ehdr);
+    eh->e_phoff = op->nphdr ? sizeof(Elf64_Ehdr) : 0;
+    eh->e_phentsize = sizeof(Elf64_Phdr);
+    eh->e_phnum = op->nphdr;
+    eh->e_shoff = op->shoff;
+    eh->e_shentsize = sizeof(Elf64_Shdr);
+    eh->e_shnum = op->nosec + 1;
+    eh->e_shstrndx = shstrndx;
+
+    phdr = (Elf64_Phdr *)(op->map + eh->e_phoff);
+    memcpy(phdr, op->phdrs, op->nphdr * sizeof(*phdr));
+
+    /* Entry zero stays the NULL section */
+    shdr = (Elf64_Shdr *)(op->map + op->shoff);
+    for (i = 0; i < op->nosec; ++i) {
+        osp = &op->osecs[i];
+        shdr[i + 1].sh_name = osp->name_off;
+        shdr[i + 1].sh_type = osp->type;
+        shdr[i + 1].sh_flags = osp->flags;
+        shdr[i + 1].sh_addr = osp->addr;
+        shdr[i + 1].sh_offset = osp->offset;
+        shdr[i + 1].sh_size = osp->size;
+        shdr[i + 1].sh_addralign = osp->align;
+    }
+
+    if (first->data != LDO_HOST_DATA) {
+        ldo_bswap_shdrs(shdr, op->nosec + 1);
+        ldo_bswap_phdrs(phdr, op->nphdr);
+        ldo_bswap_ehdr(eh);
+    }
+}
+
+/*
+ * Build .shstrtab out of every output
+ * section name.
+ */
+char *
+ldo_output_shstrtab(struct ldo_output *op, size_t *sizep)
+{
+    char *buf, *p;
+    size_t i, size = 1;
+
+    for (i = 0; i < op->nosec; ++i) {
+        size += strlen(op->osecs[i].name) + 1;
+    }
+
+    if ((buf = calloc(1, size)) == NULL)
+        return NULL;
+
+    p = buf + 1;
+    for (i = 0; i < op->nosec; ++i) {
+        op->osecs[i].name_off = p - buf;
+        p = stpcpy(p, op->osecs[i].name) + 1;
+    }
+
+    *sizep = size;
+    return buf;
+}
+
+/*
+ * Create the file an output is written to. That is
+ * a temporary file next to `pathname' that only
+ * ldo_output_commit() renames into place, so a failed
+ * link leaves no half written image behind and a
+ * running one is never scribbled over. Anything that
+ * is there but not a regular file, such as /dev/null,
+ * is written to directly.
+ */
+static int
+out_create(struct ldo_output *op)
+{
+    size_t len = strlen(op->pathname);
+    struct stat sb;
+    mode_t mask;
+
+    if (stat(op->pathname, &sb) == 0 && !S_ISREG(sb.st_mode)) {
+        if ((op->fd = open(op->pathname, O_RDWR | O_TRUNC)) < 0) {
+            fprintf(stderr, "ldo: cannot create \"%s\"\n", op->pathname);
+            perror("open");
+            return -EIO;
+        }
+        return 0;
+    }
+
+    if ((op->tmppath = malloc(len + sizeof(".XXXXXX"))) == NULL)
+        return -ENOMEM;
+    memcpy(op->tmppath, op->pathname, len);
+    memcpy(op->tmppath + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    if ((op->fd = mkstemp(op->tmppath)) < 0) {
+        fprintf(stderr, "ldo: cannot create \"%s\"\n", op->pathname);
+        perror("mkstemp");
+        free(op->tmppath);
+        op->tmppath = NULL;
+        return -EIO;
+    }
+
+    /* Same mode open(..., 0755) would have given it */
+    mask = umask(0);
+    umask(mask);
+    if (fchmod(op->fd, 0755 & ~mask) < 0) {
+        perror("fchmod");
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/*
+ * Create the output file at its final size and
+ * map it.
+ */
+int
+ldo_output_map(struct ldo_output *op)
+{
+    int err;
+
+    if ((err = out_create(op)) < 0)
+        return err;
+
+    if (ftruncate(op->fd, op->size) < 0) {
+        perror("ftruncate");
+        return -EIO;
+    }
+
+    op->map = mmap(NULL, op->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        op->fd, 0);
+    if (op->map == MAP_FAILED) {
+        perror("mmap");
+        op->map = NULL;
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/*
+ * Move a fully written output into place.
+ */
+int
+ldo_output_commit(struct ldo_output *op)
+{
+    if (op->tmppath == NULL)
+        return 0;
+    if (rename(op->tmppath, op->pathname) < 0) {
+        fprintf(stderr, "ldo: cannot create \"%s\"\n", op->pathname);
+        perror("rename");
+        return -EIO;
+    }
+
+    free(op->tmppath);
+    op->tmppath = NULL;
+    return 0;
+}
+
+/*
+ * Release everything an output holds. An output
+ * that was never committed is removed.
+ */
+void
+ldo_output_free(struct ldo_output *op)
+{
+    size_t i;
+
+    if (op->map != NULL)
+        munmap(op->map, op->size);
+    if (op->fd >= 0)
+        close(op->fd);
+    if (op->tmppath != NULL) {
+        unlink(op->tmppath);
+        free(op->tmppath);
+    }
+
+    for (i = 0; i < op->nosec; ++i) {
+        free(op->osecs[i].isecs);
+        free(op->osecs[i].buf);
+    }
+
+    free(op->osecs);
+    free(op->isecs);
+    free(op->phdrs);
+}
+
+/*
+ * Lay out and write the output image.
+ *
+ * @iq: Every input of this link.
+ * @qp: Static arrays to pack into .static_array.
+ * @pathname: Output pathname.
+ */
+int
+ldo_output_write(struct ldo_inputq *iq, struct sarry_objq *qp,
+    const char *pathname)
+{
+    const struct ldo_opts *opts = ldo_rtopts();
+    struct ldo_output out;
+    struct ldo_dbgfile dbg;
+    struct ldo_mergeq merges;
+    struct ldo_relax relax;
+    struct ldo_osec *osp, *bid = NULL, *shstr = NULL, *sarry;
+    struct bid_note note;
+    struct ldo_input *first, *in;
+    char *shstrtab = NULL, *link = NULL;
+    void *sarry_buf = NULL;
+    size_t i, shstrsz, sarry_size, shstrndx = 0;
+    uint64_t id;
+    int err;
+
+    if ((first = TAILQ_FIRST(&iq->q)) == NULL) {
+        fprintf(stderr, "ldo: no inputs, not writing \"%s\"\n", pathname);
+        return -EINVAL;
+    }
+
+    TAILQ_FOREACH(in, &iq->q, link) {
+        if (in->data != first->data || in->mach != first->mach) {
+            fprintf(stderr, "ldo: \"%s\" does not match \"%s\"\n",
+                in->pathname, first->pathname);
+            return -EINVAL;
+        }
+    }
+
+    memset(&out, 0, sizeof(out));
+    memset(&dbg, 0, sizeof(dbg));
+    out.pathname = pathname;
+    out.fd = -1;
+    dbg.out.fd = -1;
+    TAILQ_INIT(&merges);
+    memset(&relax, 0, sizeof(relax));
+
+    if ((err = ldo_layout_group(&out, iq)) < 0)
+        goto done;
+    if ((err = ldo_merge_strings(&out, &merges)) < 0)
+        goto done;
+
+    if ((ldo_rtflags() & LDO_F_BUILD_ID) != 0) {
+        memset(&note, 0, sizeof(note));
+        note.nhdr.n_namesz = sizeof(note.name);
+        note.nhdr.n_descsz = sizeof(note.desc);
+        note.nhdr.n_type = NT_GNU_BUILD_ID;
+        memcpy(note.name, "GNU", 4);
+        if (first->data != LDO_HOST_DATA)
+            ldo_bswap_nhdr(&note.nhdr);
+
+        bid = ldo_osec_new(&out, ".note.gnu.build-id", SHT_NOTE, SHF_ALLOC);
+        if (bid == NULL) {
+            err = -ENOMEM;
+            goto done;
+        }
+        bid->data = &note;
+        bid->size = sizeof(note);
+        bid->align = 4;
+    }
+
+    if (qp->count > 0) {
+        sarry_buf = ldo_sarry_build(qp, first->data, &sarry_size);
+        if (sarry_buf == NULL) {
+            err = -ENOMEM;
+            goto done;
+        }
+
+        sarry = ldo_osec_new(&out, SARRY_SECTION, SHT_PROGBITS, SHF_ALLOC);
+        if (sarry == NULL) {
+            err = -ENOMEM;
+            goto done;
+        }
+        sarry->data = sarry_buf;
+        sarry->size = sarry_size;
+        sarry->align = 8;
+    }
+
+    if (ldo_osec_new(&out, ".shstrtab", SHT_STRTAB, 0) == NULL) {
+        err = -ENOMEM;
+        goto done;
+    }
+
+    if ((err = ldo_layout_size(&out)) < 0)
+        goto done;
+    if ((ldo_rtflags() & LDO_F_ZDEBUG) != 0 &&
+        (err = ldo_compress_debug(&out, first->data)) < 0)
+        goto done;
+    if (opts->debug_path != NULL &&
+        (err = ldo_dbg_split(&out, &dbg, opts->debug_path)) < 0)
+        goto done;
+
+    /* Names are final once sections stop coming and going */
+    for (i = 0; i < out.nosec; ++i) {
+        osp = &out.osecs[i];
+        if (osp->type == SHT_STRTAB && osp->nisec == 0) {
+            shstr = osp;
+            break;
+        }
+    }
+
+    if (shstr == NULL) {
+        fprintf(stderr, "ldo_output_write: lost .shstrtab\n");
+        err = -EINVAL;
+        goto done;
+    }
+
+    if ((shstrtab = ldo_output_shstrtab(&out, &shstrsz)) == NULL) {
+        err = -ENOMEM;
+        goto done;
+    }
+
+    shstr->data = shstrtab;
+    shstr->size = shstrsz;
+
+    if ((err = ldo_layout_assign(&out)) < 0)
+        goto done;
+    if ((err = ldo_map_write(&out, qp)) < 0)
+        goto done;
+    if ((err = ldo_output_map(&out)) < 0)
+        goto done;
+    if (opts->debug_path != NULL &&
+        (err = ldo_dbg_start(&dbg, &out, first)) < 0)
+        goto done;
+
+    /* Sections moved around, find the synthetic ones again */
+    bid = NULL;
+    for (i = 0; i < out.nosec; ++i) {
+        osp = &out.osecs[i];
+        if (osp->data == NULL)
+            continue;
+
+        if (osp->data == shstrtab)
+            shstrndx = i + 1;
+        else if (osp->data == &note)
+            bid = osp;
+        else if (osp->data == dbg.link)
+            link = out.map + osp->offset;
+        memcpy(out.map + osp->offset, osp->data, osp->size);
+    }
+
+    ldo_output_headers(&out, first, shstrndx);
+
+    if ((ldo_rtflags() & LDO_F_NO_RELAX) == 0) {
+        if ((err = ldo_relax_init(&relax, iq)) < 0)
+            goto done;
+        out.relax = &relax;
+    }
+
+    ldo_parallel_for(out.nisec, out_copy_work, &out);
+
+    if (opts->debug_path != NULL && (err = ldo_dbg_finish(&dbg, link)) < 0)
+        goto done;
+    if ((err = out.err) < 0)
+        goto done;
+    if (relax.nrelax > 0)
+        vlog("relax: %zu GOT references made direct\n", relax.nrelax);
+
+    /* Hash the finished image with the ID still zeroed */
+    if (bid != NULL) {
+        if ((err = ldo_build_id(out.map, out.size, note.desc)) < 0)
+            goto done;
+        memcpy(out.map + bid->offset, &note, sizeof(note));
+        for (i = 0, id = 0; i < LDO_BUILDID_SIZE; ++i) {
+            id = (id << 8) | note.desc[i];
+        }
+        vlog("build-id: 0x%016llx\n", (unsigned long long)id);
+    }
+
+    /* The debug file goes first, the image must not point at nothing */
+    if (opts->debug_path != NULL && (err = ldo_output_commit(&dbg.out)) < 0)
+        goto done;
+    if ((err = ldo_output_commit(&out)) < 0) {
+        if (opts->debug_path != NULL)
+            unlink(dbg.out.pathname);
+        goto done;
+    }
+
+    vlog("output: %s, %zu sections, %zu bytes\n", pathname, out.nosec,
+        out.size);
+done:
+    if (err == -ENOMEM)
+        fprintf(stderr, "ldo_output_write: out of memory\n");
+    ldo_output_free(&out);
+    ldo_dbg_free(&dbg);
+    ldo_merge_free(&merges);
+    ldo_relax_free(&relax);
+    free(shstrtab);
+    free(sarry_buf);
+    return err;
+}
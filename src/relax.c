@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * GOT relaxation. Nothing in a static image can be
+ * preempted, so a GOT slot only ever holds the address
+ * of something in the image itself. References the
+ * assembler marked as relaxable are rewritten to reach
+ * their target directly instead:
+ *
+ *  x86_64:  mov  foo@GOTPCREL(%rip), %reg  ->  lea  foo(%rip), %reg
+ *           call *foo@GOTPCREL(%rip)       ->  addr32 call foo
+ *           jmp  *foo@GOTPCREL(%rip)       ->  jmp  foo; nop
+ *
+ *  aarch64: adrp xN, :got:foo              ->  adrp xN, foo
+ *           ldr  xM, [xN, :got_lo12:foo]   ->  add  xM, xN, :lo12:foo
+ *
+ * A relaxed reference no longer needs a GOT slot, so its
+ * final displacement is written along with the opcode.
+ * Instructions are little endian on both machines,
+ * whatever the byte order of the data.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ldo/relax.h>
+#include <ldo/output.h>
+#include <ldo/merge.h>
+#include <ldo/hash.h>
+#include <ldo/cdefs.h>
+
+static inline uint32_t
+relax_rd32(const char *p)
+{
+    const uint8_t *b = (const uint8_t *)p;
+
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static inline void
+relax_wr32(char *p, uint32_t v)
+{
+    uint8_t *b = (uint8_t *)p;
+
+    b[0] = v;
+    b[1] = v >> 8;
+    b[2] = v >> 16;
+    b[3] = v >> 24;
+}
+
+static struct ldo_relax_sym *
+relax_slot(const struct ldo_relax *rp, const char *name)
+{
+    size_t mask = rp->nslots - 1;
+    size_t i;
+
+    i = ldo_hash64(name, strlen(name), 0) & mask;
+    while (rp->slots[i].name != NULL) {
+        if (strcmp(rp->slots[i].name, name) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &rp->slots[i];
+}
+
+static int
+relax_grow(struct ldo_relax *rp)
+{
+    struct ldo_relax nr;
+    struct ldo_relax_sym *sp;
+    size_t i;
+
+    nr.nslots = rp->nslots ? rp->nslots * 2 : 1024;
+    nr.slots = calloc(nr.nslots, sizeof(*nr.slots));
+    if (nr.slots == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < rp->nslots; ++i) {
+        if (rp->slots[i].name == NULL)
+            continue;
+        sp = relax_slot(&nr, rp->slots[i].name);
+        *sp = rp->slots[i];
+    }
+
+    free(rp->slots);
+    rp->slots = nr.slots;
+    rp->nslots = nr.nslots;
+    return 0;
+}
+
+/*
+ * Add the global definitions of an input. A strong
+ * definition wins over a weak one, otherwise the
+ * first one seen does.
+ */
+static int
+relax_add(struct ldo_relax *rp, struct ldo_input *in)
+{
+    const Elf64_Sym *sym, *old;
+    struct ldo_relax_sym *sp;
+    const char *name;
+    size_t i;
+
+    for (i = 1; i < in->nsym; ++i) {
+        sym = &in->syms[i];
+        if (ELF64_ST_BIND(sym->st_info) == STB_LOCAL)
+            continue;
+        if (sym->st_shndx == SHN_UNDEF || sym->st_shndx == SHN_COMMON)
+            continue;
+        name = ldo_input_symname(in, i);
+        if (*name == '\0')
+            continue;
+
+        if ((rp->count + 1) * 2 > rp->nslots && relax_grow(rp) < 0)
+            return -ENOMEM;
+
+        sp = relax_slot(rp, name);
+        if (sp->name != NULL) {
+            old = &sp->in->syms[sp->symidx];
+            if (ELF64_ST_BIND(old->st_info) != STB_WEAK ||
+                ELF64_ST_BIND(sym->st_info) == STB_WEAK)
+                continue;
+        } else {
+            ++rp->count;
+        }
+
+        sp->name = name;
+        sp->in = in;
+        sp->symidx = i;
+    }
+
+    return 0;
+}
+
+/*
+ * Find the address of `off' bytes into an input
+ * section, wherever it ended up in the image.
+ */
+static int
+relax_secaddr(struct ldo_isec *isp, uint64_t off, uint64_t *resp)
+{
+    const struct ldo_osec *osp;
+    uint64_t res;
+
+    if (isp->merge != NULL) {
+        if (ldo_merge_offset(isp, off, &res) < 0)
+            return -ENOENT;
+        osp = isp->merge->mp->isec.osec;
+    } else {
+        isp = isp->repl;
+        osp = isp->osec;
+        res = isp->off + off;
+    }
+
+    if (osp == NULL || (osp->flags & SHF_ALLOC) == 0)
+        return -ENOENT;
+
+    *resp = osp->addr + res;
+    return 0;
+}
+
+/*
+ * Find the address a relocation's symbol resolves
+ * to. Fails for anything that really does need its
+ * GOT slot: undefined, common, TLS and IFUNC symbols.
+ */
+static int
+relax_symaddr(const struct ldo_relax *rp, struct ldo_input *in,
+    size_t symidx, uint64_t *resp)
+{
+    const struct ldo_relax_sym *sp;
+    const Elf64_Sym *sym;
+    struct ldo_isec *tsec;
+
+    if (symidx == 0 || symidx >= in->nsym)
+        return -ENOENT;
+
+    sym = &in->syms[symidx];
+    if (ELF64_ST_BIND(sym->st_info) != STB_LOCAL) {
+        sp = relax_slot(rp, ldo_input_symname(in, symidx));
+        if (sp->name == NULL)
+            return -ENOENT;
+        in = sp->in;
+        symidx = sp->symidx;
+        sym = &in->syms[symidx];
+    }
+
+    switch (ELF64_ST_TYPE(sym->st_info)) {
+    case STT_TLS:
+    case STT_GNU_IFUNC:
+        return -ENOENT;
+    }
+
+    if (sym->st_shndx == SHN_ABS) {
+        *resp = sym->st_value;
+        return 0;
+    }
+
+    if ((tsec = ldo_input_symsec(in, symidx)) == NULL)
+        return -ENOENT;
+
+    return relax_secaddr(tsec, sym->st_value, resp);
+}
+
+/*
+ * Relax one R_X86_64_[REX_]GOTPCRELX reference, the
+ * 32-bit field at `loc' follows the opcode and ModRM.
+ * Returns 1 if the instruction was rewritten.
+ */
+static int
+relax_x86(const Elf64_Rela *r, char *loc, uint64_t s, uint64_t p)
+{
+    uint8_t op = loc[-2], modrm = loc[-1];
+    int64_t val = s + r->r_addend - p;
+
+    if (val != (int32_t)val)
+        return 0;
+
+    if (op == 0x8b) {
+        loc[-2] = 0x8d;
+    } else if (ELF64_R_TYPE(r->r_info) == R_X86_64_REX_GOTPCRELX) {
+        return 0;
+    } else if (op == 0xff && modrm == 0x15) {
+        /* The prefix keeps the instruction the same length */
+        loc[-2] = 0x67;
+        loc[-1] = 0xe8;
+    } else if (op == 0xff && modrm == 0x25) {
+        /* Displacement moves up a byte, pad the end */
+        if (val + 1 != (int32_t)(val + 1))
+            return 0;
+        loc[-2] = 0xe9;
+        relax_wr32(loc - 1, val + 1);
+        loc[3] = 0x90;
+        return 1;
+    } else {
+        return 0;
+    }
+
+    relax_wr32(loc, val);
+    return 1;
+}
+
+/*
+ * Relax an ADRP+LDR pair loading a GOT slot into an
+ * ADRP+ADD pair making the address, the LDR has to
+ * follow the ADRP and use the register it sets.
+ * Returns 1 if both instructions were rewritten.
+ */
+static int
+relax_aarch64(const Elf64_Rela *r, const Elf64_Rela *next, char *loc,
+    uint64_t s, uint64_t p)
+{
+    uint32_t adrp, ldr, rd, rt;
+    int64_t pages;
+
+    if (ELF64_R_TYPE(next->r_info) != R_AARCH64_LD64_GOT_LO12_NC)
+        return 0;
+    if (ELF64_R_SYM(next->r_info) != ELF64_R_SYM(r->r_info))
+        return 0;
+    if (next->r_offset != r->r_offset + 4)
+        return 0;
+    if (r->r_addend != 0 || next->r_addend != 0)
+        return 0;
+
+    adrp = relax_rd32(loc);
+    ldr = relax_rd32(loc + 4);
+    if ((adrp & 0x9f000000) != 0x90000000)
+        return 0;
+    if ((ldr & 0xffc00000) != 0xf9400000)
+        return 0;
+
+    rd = adrp & 0x1f;
+    rt = ldr & 0x1f;
+    if (((ldr >> 5) & 0x1f) != rd)
+        return 0;
+
+    pages = (int64_t)(s >> 12) - (int64_t)(p >> 12);
+    if (pages < -(1LL << 20) || pages >= (1LL << 20))
+        return 0;
+
+    adrp &= 0x9f00001f;
+    adrp |= (pages & 0x3) << 29;
+    adrp |= ((pages >> 2) & 0x7ffff) << 5;
+    relax_wr32(loc, adrp);
+    relax_wr32(loc + 4, 0x91000000 | ((s & 0xfff) << 10) | (rd << 5) | rt);
+    return 1;
+}
+
+/*
+ * Collect the global definitions of a link. Links
+ * for machines there is nothing to relax on leave
+ * `rp' empty.
+ *
+ * @rp: Relaxation state to set up.
+ * @iq: Every input of this link.
+ */
+int
+ldo_relax_init(struct ldo_relax *rp, struct ldo_inputq *iq)
+{
+    struct ldo_input *in;
+    int err;
+
+    memset(rp, 0, sizeof(*rp));
+    if ((in = TAILQ_FIRST(&iq->q)) == NULL)
+        return 0;
+
+    rp->mach = in->mach;
+    if (rp->mach != LDO_X86_64 && rp->mach != LDO_AARCH64)
+        return 0;
+    if ((err = relax_grow(rp)) < 0)
+        return err;
+
+    TAILQ_FOREACH(in, &iq->q, link) {
+        if ((err = relax_add(rp, in)) < 0)
+            return err;
+    }
+
+    return 0;
+}
+
+/*
+ * Relax the GOT references of an input section
+ * once it has been copied out.
+ *
+ * @rp: Relaxation state of the link.
+ * @isp: Input section, already laid out.
+ * @dst: Where its contents were copied to.
+ */
+void
+ldo_relax_isec(struct ldo_relax *rp, const struct ldo_isec *isp, char *dst)
+{
+    const Elf64_Rela *r;
+    uint64_t base, s;
+    size_t i, n = 0;
+
+    if (rp->slots == NULL || isp->nrela == 0)
+        return;
+    if ((isp->osec->flags & SHF_ALLOC) == 0 || isp->size < 4)
+        return;
+
+    base = isp->osec->addr + isp->off;
+    for (i = 0; i < isp->nrela; ++i) {
+        r = &isp->rela[i];
+        if (r->r_offset > isp->size - 4)
+            continue;
+
+        switch (ELF64_R_TYPE(r->r_info)) {
+        case R_X86_64_REX_GOTPCRELX:
+        case R_X86_64_GOTPCRELX:
+            if (rp->mach != LDO_X86_64 || r->r_offset < 2)
+                continue;
+            if (relax_symaddr(rp, isp->in, ELF64_R_SYM(r->r_info), &s) < 0)
+                continue;
+            n += relax_x86(r, dst + r->r_offset, s, base + r->r_offset);
+            break;
+        case R_AARCH64_ADR_GOT_PAGE:
+            if (rp->mach != LDO_AARCH64 || i + 1 == isp->nrela)
+                continue;
+            if (r->r_offset > isp->size - 8)
+                continue;
+            if (relax_symaddr(rp, isp->in, ELF64_R_SYM(r->r_info), &s) < 0)
+                continue;
+            if (relax_aarch64(r, r + 1, dst + r->r_offset, s,
+                base + r->r_offset)) {
+                ++n;
+                ++i;
+            }
+            break;
+        }
+    }
+
+    if (n > 0)
+        __atomic_add_fetch(&rp->nrelax, n, __ATOMIC_RELAXED);
+}
+
+/*
+ * Release the definitions collected for a link.
+ *
+ * @rp: Relaxation state.
+ */
+void
+ldo_relax_free(struct ldo_relax *rp)
+{
+    free(rp->slots);
+    rp->slots = NULL;
+    rp->nslots = 0;
+    rp->count = 0;
+}
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Static arrays. Every input section called
+ * .static_array.<name> is taken out of the normal
+ * layout, compressed in blocks of SARRY_BLOCK_SIZE
+ * and packed into one .static_array section with an
+ * index the runtime can look arrays up in. Blocks
+ * are compressed independently so any part of an
+ * array can be read without inflating the rest.
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/object.h>
+#include <ldo/input.h>
+#include <ldo/compress.h>
+#include <ldo/sarry.h>
+#include <ldo/bswap.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+#include <lz4.h>
+
+/*
+ * Compression state.
+ *
+ * @objs: Queued objects, one per array.
+ * @isecs: Input section of each object.
+ * @nresident: Arrays compressed by an earlier link.
+ * @err: Set by any work item that fails.
+ */
+struct pack_ctx {
+    struct sarry_obj **objs;
+    struct ldo_isec **isecs;
+    size_t nresident;
+    int err;
+};
+
+/*
+ * Compress an input section block by block.
+ * Sections compressed in the input are inflated
+ * first, the blocks are made from the contents.
+ *
+ * @isp: Input section.
+ * @resp: Set to the packed section.
+ */
+static int
+pack_new(const struct ldo_isec *isp, struct sarry_pack **resp)
+{
+    struct sarry_pack *pp;
+    const char *src = isp->data;
+    char *tmp = NULL;
+    size_t i, len, bound, off = 0;
+    int n, err;
+
+    if (isp->zsize != 0) {
+        if ((tmp = malloc(isp->size ? isp->size : 1)) == NULL)
+            return -ENOMEM;
+        if ((err = ldo_isec_copy(isp, tmp)) < 0) {
+            free(tmp);
+            return err;
+        }
+        src = tmp;
+    }
+
+    if ((pp = calloc(1, sizeof(*pp))) == NULL) {
+        free(tmp);
+        return -ENOMEM;
+    }
+
+    pp->nblock = (isp->size + SARRY_BLOCK_SIZE - 1) / SARRY_BLOCK_SIZE;
+    bound = LZ4_COMPRESSBOUND(SARRY_BLOCK_SIZE);
+    pp->blocks = malloc((pp->nblock + 1) * sizeof(*pp->blocks));
+    pp->cdata = malloc(pp->nblock * bound + 1);
+    if (pp->blocks == NULL || pp->cdata == NULL) {
+        ldo_sarry_free(pp);
+        free(tmp);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < pp->nblock; ++i) {
+        len = isp->size - i * SARRY_BLOCK_SIZE;
+        if (len > SARRY_BLOCK_SIZE)
+            len = SARRY_BLOCK_SIZE;
+
+        pp->blocks[i] = off;
+        n = LZ4_compress_default(src, pp->cdata + off, len, bound);
+
+        /* Store it as is if it did not shrink */
+        if (n <= 0 || (size_t)n >= len) {
+            memcpy(pp->cdata + off, src, len);
+            n = len;
+        }
+
+        off += n;
+        src += len;
+    }
+
+    pp->blocks[pp->nblock] = off;
+    pp->size = off;
+    free(tmp);
+    *resp = pp;
+    return 0;
+}
+
+/*
+ * Compress one array unless an earlier link already
+ * did, runs on the worker pool.
+ */
+static void
+pack_work(size_t idx, void *arg)
+{
+    struct pack_ctx *ctx = arg;
+    struct sarry_obj *obj = ctx->objs[idx];
+    struct ldo_isec *isp = ctx->isecs[idx];
+    int err;
+
+    if (isp->pack != NULL) {
+        __atomic_add_fetch(&ctx->nresident, 1, __ATOMIC_RELAXED);
+    } else if ((err = pack_new(isp, &isp->pack)) < 0) {
+        __atomic_store_n(&ctx->err, err, __ATOMIC_RELAXED);
+        return;
+    }
+
+    obj->cdata = isp->pack->cdata;
+    obj->size = isp->pack->size;
+    obj->blocks = isp->pack->blocks;
+    obj->nblock = isp->pack->nblock;
+}
+
+/*
+ * Queue every static array of a link and
+ * compress them in parallel. The input sections
+ * are flagged so the layout leaves them out.
+ *
+ * @iq: Every input of this link.
+ * @qp: Queue to fill.
+ */
+int
+ldo_sarry_collect(struct ldo_inputq *iq, struct sarry_objq *qp)
+{
+    struct pack_ctx ctx;
+    struct sarry_obj obj, *objp;
+    struct ldo_input *in;
+    struct ldo_isec *isp;
+    size_t i, n = 0, cap = 0;
+    void *p;
+    int err = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    TAILQ_FOREACH(in, &iq->q, link) {
+        for (i = 0; i < in->nsec; ++i) {
+            isp = &in->isecs[i];
+            if (strncmp(isp->name, SARRY_PREFIX, sizeof(SARRY_PREFIX) - 1))
+                continue;
+            if (isp->shdr->sh_type != SHT_PROGBITS || isp->data == NULL)
+                continue;
+
+            if (n == cap) {
+                cap = cap ? cap * 2 : 16;
+                if ((p = realloc(ctx.objs, cap * sizeof(*ctx.objs))) == NULL)
+                    goto nomem;
+                ctx.objs = p;
+                if ((p = realloc(ctx.isecs, cap * sizeof(*ctx.isecs))) == NULL)
+                    goto nomem;
+                ctx.isecs = p;
+            }
+
+            memset(&obj, 0, sizeof(obj));
+            obj.pathname = in->pathname;
+            obj.name = isp->name + sizeof(SARRY_PREFIX) - 1;
+            obj.real_size = isp->size;
+            if ((objp = sarry_objq_in(qp, &obj)) == NULL) {
+                err = -ENOMEM;
+                goto done;
+            }
+
+            isp->flags |= LDO_ISEC_SARRY;
+            ctx.objs[n] = objp;
+            ctx.isecs[n++] = isp;
+        }
+    }
+
+    ldo_parallel_for(n, pack_work, &ctx);
+    if ((err = ctx.err) == -ENOMEM)
+        goto nomem;
+    if (err < 0)
+        goto done;
+
+    vlog("static arrays: %zu queued, %zu resident\n", n, ctx.nresident);
+    goto done;
+nomem:
+    fprintf(stderr, "ldo_sarry_collect: out of memory\n");
+    err = -ENOMEM;
+done:
+    free(ctx.objs);
+    free(ctx.isecs);
+    return err;
+}
+
+/*
+ * Queued array and its position in the queue,
+ * duplicates keep the one queued first.
+ */
+struct sarry_sort {
+    struct sarry_obj *obj;
+    size_t idx;
+};
+
+static int
+sarry_cmp(const void *a, const void *b)
+{
+    const struct sarry_sort *sa = a, *sb = b;
+    uint64_t ha = sarry_hash(sa->obj->name), hb = sarry_hash(sb->obj->name);
+    int cmp;
+
+    if (ha != hb)
+        return (ha < hb) ? -1 : 1;
+    if ((cmp = strcmp(sa->obj->name, sb->obj->name)) != 0)
+        return cmp;
+
+    return (sa->idx < sb->idx) ? -1 : (sa->idx > sb->idx);
+}
+
+/*
+ * Build the contents of the .static_array section
+ * from a queue, returns a buffer the caller frees or
+ * NULL if out of memory.
+ *
+ * @qp: Queue of compressed arrays.
+ * @data: Byte order of the output (ELFDATA*).
+ * @sizep: Returns the size of the section.
+ */
+void *
+ldo_sarry_build(struct sarry_objq *qp, uint8_t data, size_t *sizep)
+{
+    struct sarry_sort *objs;
+    struct sarry_obj *obj;
+    struct sarry_hdr *hdr;
+    struct sarry_ent *ent;
+    uint64_t *blocks;
+    size_t i, j, n = 0, size, tab, names, cdata;
+    char *buf;
+
+    if ((objs = calloc(qp->count + 1, sizeof(*objs))) == NULL)
+        return NULL;
+
+    for (i = 0; i < qp->next; ++i) {
+        if ((obj = sarry_objq_get(qp, i)) == NULL)
+            continue;
+        objs[n].obj = obj;
+        objs[n++].idx = i;
+    }
+
+    /* Sorted by name within a hash, so duplicates are adjacent */
+    qsort(objs, n, sizeof(*objs), sarry_cmp);
+    for (i = 1, j = n ? 1 : 0; i < n; ++i) {
+        obj = objs[i].obj;
+        if (strcmp(obj->name, objs[j - 1].obj->name) == 0) {
+            fprintf(stdout, "[warn] ldo_sarry_build: static array \"%s\" "
+                "in \"%s\" already defined in \"%s\", ignoring\n", obj->name,
+                obj->pathname, objs[j - 1].obj->pathname);
+            obj->off = 0;
+            continue;
+        }
+        objs[j++] = objs[i];
+    }
+    n = j;
+
+    size = sizeof(*hdr) + n * sizeof(*ent);
+    tab = size;
+    for (i = 0; i < n; ++i) {
+        size += (objs[i].obj->nblock + 1) * sizeof(*blocks);
+    }
+    names = size;
+    for (i = 0; i < n; ++i) {
+        size += strlen(objs[i].obj->name) + 1;
+    }
+    cdata = size;
+    for (i = 0; i < n; ++i) {
+        size += objs[i].obj->size;
+    }
+
+    if ((buf = calloc(1, size)) == NULL) {
+        free(objs);
+        return NULL;
+    }
+
+    hdr = (struct sarry_hdr *)buf;
+    hdr->magic = SARRY_MAGIC;
+    hdr->version = SARRY_VERSION;
+    hdr->codec = SARRY_CODEC_LZ4;
+    hdr->narray = n;
+    hdr->block_size = SARRY_BLOCK_SIZE;
+    hdr->size = size;
+
+    ent = (struct sarry_ent *)(hdr + 1);
+    for (i = 0; i < n; ++i, ++ent) {
+        obj = objs[i].obj;
+        ent->hash = sarry_hash(obj->name);
+        ent->name = names;
+        ent->nblock = obj->nblock;
+        ent->real_size = obj->real_size;
+        ent->blocks = tab;
+
+        names = stpcpy(buf + names, obj->name) + 1 - buf;
+        memcpy(buf + cdata, obj->cdata, obj->size);
+        obj->off = cdata;
+
+        blocks = (uint64_t *)(buf + tab);
+        for (j = 0; j <= obj->nblock; ++j) {
+            blocks[j] = cdata + obj->blocks[j];
+        }
+        if (data != LDO_HOST_DATA)
+            ldo_bswap_words(blocks, obj->nblock + 1);
+
+        tab += (obj->nblock + 1) * sizeof(*blocks);
+        cdata += obj->size;
+
+        if (data != LDO_HOST_DATA) {
+            ent->hash = ldo_bswap64(ent->hash);
+            ent->name = ldo_bswap32(ent->name);
+            ent->nblock = ldo_bswap32(ent->nblock);
+            ent->real_size = ldo_bswap64(ent->real_size);
+            ent->blocks = ldo_bswap64(ent->blocks);
+        }
+    }
+
+    if (data != LDO_HOST_DATA) {
+        hdr->magic = ldo_bswap32(hdr->magic);
+        hdr->version = ldo_bswap16(hdr->version);
+        hdr->codec = ldo_bswap16(hdr->codec);
+        hdr->narray = ldo_bswap32(hdr->narray);
+        hdr->block_size = ldo_bswap32(hdr->block_size);
+        hdr->size = ldo_bswap64(hdr->size);
+    }
+
+    free(objs);
+    *sizep = size;
+    return buf;
+}
+
+/*
+ * Free the compressed contents of a static array.
+ *
+ * @pp: Compressed array (or NULL).
+ */
+void
+ldo_sarry_free(struct sarry_pack *pp)
+{
+    if (pp == NULL)
+        return;
+
+    free(pp->cdata);
+    free(pp->blocks);
+    free(pp);
+}
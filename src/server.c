@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Resident link server. A long lived ldo keeps every input
+ * it has parsed, along with the compressed contents of its
+ * static arrays, and serves links sent by thin clients over
+ * a Unix socket, so repeated links skip startup, parsing and
+ * compression.
+ * Cached inputs are watched with inotify and dropped as
+ * soon as the file behind them changes.
+ */
+
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <ldo/ldo.h>
+#include <ldo/server.h>
+#include <ldo/hash.h>
+#include <ldo/cdefs.h>
+
+#define CACHE_NBUCKET   1024
+#define SRV_MAXARGC     (1 << 20)
+#define SRV_MAXLEN      (1ULL << 30)
+
+#define CACHE_WATCH (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | \
+    IN_DELETE_SELF | IN_MOVE_SELF)
+
+/*
+ * An input kept across requests.
+ *
+ * @path: Absolute pathname (cache key).
+ * @wd: inotify watch descriptor.
+ * @in: Parsed input.
+ * @busy: Set while a link is using `in'.
+ * @hlink: Hash bucket link.
+ * @link: Cache list link.
+ */
+struct cache_ent {
+    char *path;
+    int wd;
+    struct ldo_input *in;
+    int busy;
+    LIST_ENTRY(cache_ent) hlink;
+    TAILQ_ENTRY(cache_ent) link;
+};
+
+/*
+ * @active: Set when running as a server.
+ * @ifd: inotify descriptor.
+ * @buckets: Path lookup table.
+ * @ents: Every cached input.
+ * @count: Number of cached inputs.
+ * @nhit: Lookups served from the cache this request.
+ * @nmiss: Lookups that had to load the file.
+ */
+static struct {
+    int active;
+    int ifd;
+    LIST_HEAD(, cache_ent) buckets[CACHE_NBUCKET];
+    TAILQ_HEAD(, cache_ent) ents;
+    size_t count;
+    size_t nhit;
+    size_t nmiss;
+} cache;
+
+static volatile sig_atomic_t srv_stop = 0;
+
+static void
+srv_sighandler(int signo __unused)
+{
+    srv_stop = 1;
+}
+
+static int
+read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = read(fd, p, len)) < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -EIO;
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int
+write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write(fd, p, len)) < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -EIO;
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static struct cache_ent *
+cache_lookup(const char *path)
+{
+    struct cache_ent *ent;
+    size_t b;
+
+    b = ldo_hash64(path, strlen(path), 0) % CACHE_NBUCKET;
+    LIST_FOREACH(ent, &cache.buckets[b], hlink) {
+        if (strcmp(ent->path, path) == 0)
+            return ent;
+    }
+
+    return NULL;
+}
+
+static void
+cache_evict(struct cache_ent *ent, int rmwatch)
+{
+    vlog("server: dropping \"%s\"\n", ent->path);
+    if (rmwatch)
+        inotify_rm_watch(cache.ifd, ent->wd);
+
+    LIST_REMOVE(ent, hlink);
+    TAILQ_REMOVE(&cache.ents, ent, link);
+    --cache.count;
+
+    ldo_input_free(ent->in);
+    free(ent->path);
+    free(ent);
+}
+
+/*
+ * Drop every cached input whose file changed since
+ * the last request.
+ */
+static void
+cache_drain(void)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    struct cache_ent *ent, *tmp;
+    ssize_t n, off;
+
+    while ((n = read(cache.ifd, buf, sizeof(buf))) > 0) {
+        for (off = 0; off < n; off += sizeof(*ev) + ev->len) {
+            ev = (const struct inotify_event *)&buf[off];
+
+            /* Lost events, nothing can be trusted */
+            if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+                while (!TAILQ_EMPTY(&cache.ents))
+                    cache_evict(TAILQ_FIRST(&cache.ents), 1);
+                continue;
+            }
+
+            for (ent = TAILQ_FIRST(&cache.ents); ent != NULL; ent = tmp) {
+                tmp = TAILQ_NEXT(ent, link);
+                if (ent->wd == ev->wd)
+                    cache_evict(ent, (ev->mask & IN_IGNORED) == 0);
+            }
+        }
+    }
+}
+
+/*
+ * Returns a cached input for a pathname, or NULL
+ * if it has to be loaded from scratch.
+ *
+ * @pathname: Input pathname.
+ */
+struct ldo_input *
+ldo_cache_get(const char *pathname)
+{
+    struct cache_ent *ent;
+    char path[PATH_MAX];
+
+    if (!cache.active)
+        return NULL;
+
+    if (realpath(pathname, path) == NULL ||
+        (ent = cache_lookup(path)) == NULL || ent->busy) {
+        ++cache.nmiss;
+        return NULL;
+    }
+
+    ++cache.nhit;
+    ent->busy = 1;
+    ldo_input_reset(ent->in);
+    return ent->in;
+}
+
+/*
+ * Hand an input back to the cache once a link is
+ * done with it. Returns a negative value if the
+ * input was not kept and has to be freed.
+ *
+ * @in: Input to keep.
+ */
+int
+ldo_cache_put(struct ldo_input *in)
+{
+    struct cache_ent *ent;
+    struct stat sb;
+    char path[PATH_MAX];
+    size_t b;
+
+    if (!cache.active)
+        return -1;
+    if (realpath(in->pathname, path) == NULL)
+        return -1;
+
+    if ((ent = cache_lookup(path)) != NULL) {
+        if (ent->in != in)
+            return -1;
+        ent->busy = 0;
+        return 0;
+    }
+
+    if ((ent = calloc(1, sizeof(*ent))) == NULL)
+        return -1;
+    if ((ent->path = strdup(path)) == NULL) {
+        free(ent);
+        return -1;
+    }
+
+    ent->wd = inotify_add_watch(cache.ifd, path, CACHE_WATCH);
+    if (ent->wd < 0) {
+        free(ent->path);
+        free(ent);
+        return -1;
+    }
+
+    /* Changed before the watch went up? */
+    if (stat(path, &sb) < 0 || (size_t)sb.st_size != in->lfp->file_size ||
+        sb.st_mtim.tv_sec != in->lfp->mtime.tv_sec ||
+        sb.st_mtim.tv_nsec != in->lfp->mtime.tv_nsec) {
+        free(ent->path);
+        free(ent);
+        return -1;
+    }
+
+    ent->in = in;
+    in->pathname = ent->path;
+
+    b = ldo_hash64(path, strlen(path), 0) % CACHE_NBUCKET;
+    LIST_INSERT_HEAD(&cache.buckets[b], ent, hlink);
+    TAILQ_INSERT_TAIL(&cache.ents, ent, link);
+    ++cache.count;
+    return 0;
+}
+
+/*
+ * Serve a single link request.
+ *
+ * @cfd: Client socket.
+ * @run: Link entry point.
+ */
+static int
+srv_serve(int cfd, ldo_run_t run)
+{
+    struct ldo_srv_req req;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    char cbuf[CMSG_SPACE(2 * sizeof(int))];
+    char *payload = NULL, *p, *end;
+    char **argv = NULL;
+    int fds[2] = { -1, -1 };
+    int saved[2] = { -1, -1 };
+    int oldcwd = -1;
+    int32_t status = -1;
+    uint32_t i;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &req;
+    iov.iov_len = sizeof(req);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    if (recvmsg(cfd, &msg, MSG_WAITALL) != sizeof(req))
+        goto done;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+        goto done;
+
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    if (req.magic != LDO_SRV_MAGIC || req.argc == 0 ||
+        req.argc > SRV_MAXARGC || req.len > SRV_MAXLEN)
+        goto done;
+
+    payload = malloc(req.len + 1);
+    argv = calloc(req.argc + 1, sizeof(*argv));
+    if (payload == NULL || argv == NULL)
+        goto done;
+    if (read_full(cfd, payload, req.len) < 0)
+        goto done;
+
+    /* Split up the working directory and arguments */
+    payload[req.len] = '\0';
+    end = payload + req.len;
+    p = payload + strlen(payload) + 1;
+    for (i = 0; i < req.argc; ++i) {
+        if (p >= end)
+            goto done;
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    if ((oldcwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        goto done;
+    if (chdir(payload) < 0)
+        goto done;
+
+    fflush(stdout);
+    fflush(stderr);
+    saved[0] = dup(STDOUT_FILENO);
+    saved[1] = dup(STDERR_FILENO);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+
+    cache.nhit = 0;
+    cache.nmiss = 0;
+    status = run(req.argc, argv);
+    vlog("server: %zu inputs cached, %zu loaded, %zu resident\n",
+        cache.nhit, cache.nmiss, cache.count);
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved[0], STDOUT_FILENO);
+    dup2(saved[1], STDERR_FILENO);
+    close(saved[0]);
+    close(saved[1]);
+done:
+    if (oldcwd >= 0) {
+        fchdir(oldcwd);
+        close(oldcwd);
+    }
+    if (fds[0] >= 0)
+        close(fds[0]);
+    if (fds[1] >= 0)
+        close(fds[1]);
+
+    write_full(cfd, &status, sizeof(status));
+    free(payload);
+    free(argv);
+    return status;
+}
+
+/*
+ * Returns true if a server answers on a socket.
+ */
+static int
+srv_alive(const struct sockaddr_un *sun)
+{
+    int fd, alive;
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+        return 0;
+
+    alive = connect(fd, (const struct sockaddr *)sun, sizeof(*sun)) == 0;
+    close(fd);
+    return alive;
+}
+
+/*
+ * Serve link requests on a Unix socket until
+ * SIGINT or SIGTERM.
+ *
+ * @sockpath: Socket pathname.
+ * @run: Link entry point, called for every request.
+ */
+int
+ldo_server(const char *sockpath, ldo_run_t run)
+{
+    struct sockaddr_un sun;
+    struct sigaction sa;
+    struct pollfd pfd[2];
+    struct stat sb;
+    size_t i, npfd;
+    int lfd, cfd;
+
+    if (strlen(sockpath) >= sizeof(sun.sun_path)) {
+        fprintf(stderr, "ldo_server: socket path too long\n");
+        return -1;
+    }
+
+    TAILQ_INIT(&cache.ents);
+    for (i = 0; i < CACHE_NBUCKET; ++i) {
+        LIST_INIT(&cache.buckets[i]);
+    }
+
+    cache.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache.ifd < 0) {
+        perror("inotify_init1");
+        fprintf(stderr, "[warn] ldo_server: inputs will not be cached\n");
+    }
+    cache.active = (cache.ifd >= 0);
+
+    if ((lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, sockpath);
+
+    /* Clean up after a server that did not exit, never a live one */
+    if (lstat(sockpath, &sb) == 0 && S_ISSOCK(sb.st_mode)) {
+        if (srv_alive(&sun)) {
+            fprintf(stderr, "ldo_server: a server is already on %s\n",
+                sockpath);
+            close(lfd);
+            return -1;
+        }
+        unlink(sockpath);
+    }
+
+    if (bind(lfd, (struct sockaddr *)&sun, sizeof(sun)) < 0 ||
+        listen(lfd, 16) < 0) {
+        perror("ldo_server");
+        close(lfd);
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = srv_sighandler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("ldo: serving on %s\n", sockpath);
+    fflush(stdout);
+
+    while (!srv_stop) {
+        pfd[0].fd = lfd;
+        pfd[0].events = POLLIN;
+        pfd[1].fd = cache.ifd;
+        pfd[1].events = POLLIN;
+        npfd = cache.active ? 2 : 1;
+
+        if (poll(pfd, npfd, -1) < 0)
+            continue;
+        if (cache.active)
+            cache_drain();
+        if ((pfd[0].revents & POLLIN) == 0)
+            continue;
+        if ((cfd = accept(lfd, NULL, NULL)) < 0)
+            continue;
+
+        srv_serve(cfd, run);
+        close(cfd);
+    }
+
+    while (!TAILQ_EMPTY(&cache.ents))
+        cache_evict(TAILQ_FIRST(&cache.ents), 1);
+
+    cache.active = 0;
+    if (cache.ifd >= 0)
+        close(cache.ifd);
+
+    close(lfd);
+    unlink(sockpath);
+    return 0;
+}
+
+/*
+ * Send a link to a running server and wait for
+ * it to finish, returns the exit status of the
+ * link.
+ *
+ * @sockpath: Socket pathname.
+ * @argc: Argument count.
+ * @argv: Arguments, sent as-is.
+ */
+int
+ldo_client(const char *sockpath, int argc, char **argv)
+{
+    struct sockaddr_un sun;
+    struct ldo_srv_req req;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    char cbuf[CMSG_SPACE(2 * sizeof(int))];
+    char cwd[PATH_MAX];
+    int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+    char *payload, *p;
+    int32_t status;
+    size_t len;
+    int i, sfd;
+
+    if (strlen(sockpath) >= sizeof(sun.sun_path)) {
+        fprintf(stderr, "ldo_client: socket path too long\n");
+        return -1;
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        perror("getcwd");
+        return -1;
+    }
+
+    len = strlen(cwd) + 1;
+    for (i = 0; i < argc; ++i) {
+        len += strlen(argv[i]) + 1;
+    }
+
+    if ((payload = malloc(len)) == NULL)
+        return -1;
+
+    p = stpcpy(payload, cwd) + 1;
+    for (i = 0; i < argc; ++i) {
+        p = stpcpy(p, argv[i]) + 1;
+    }
+
+    if ((sfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        perror("socket");
+        free(payload);
+        return -1;
+    }
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, sockpath);
+    if (connect(sfd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+        fprintf(stderr, "ldo_client: no server on %s\n", sockpath);
+        close(sfd);
+        free(payload);
+        return -1;
+    }
+
+    req.magic = LDO_SRV_MAGIC;
+    req.argc = argc;
+    req.len = len;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    iov.iov_base = &req;
+    iov.iov_len = sizeof(req);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    fflush(stdout);
+    fflush(stderr);
+    if (sendmsg(sfd, &msg, 0) != sizeof(req) ||
+        write_full(sfd, payload, len) < 0 ||
+        read_full(sfd, &status, sizeof(status)) < 0) {
+        fprintf(stderr, "ldo_client: lost connection to server\n");
+        status = -1;
+    }
+
+    close(sfd);
+    free(payload);
+    return status;
+}
@@ -0,0 +1,485 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Section hash cache (--hash-cache). The cache file records
+ * every input of the last link along with its size, mtime,
+ * the content hash of each of its sections and its static
+ * arrays as they were compressed. Inputs that have not
+ * changed since get their hashes and compressed arrays
+ * restored rather than hashing and compressing them again.
+ * Every input is still read and indexed and the output is
+ * laid out and written in full; the layout is one linear
+ * pass over the sections, checking a saved one would cost
+ * as much. Inputs a manifest gave a content hash for are
+ * matched by that hash rather than by their mtime.
+ *
+ * Layout (native byte order):
+ *
+ *      struct ldo_state_hdr
+ *      struct ldo_state_ent, pathname padded to 8 bytes,
+ *          uint64_t hashes[nsec]
+ *          struct ldo_state_pack, uint64_t blocks[nblock + 1],
+ *              compressed data padded to 8 bytes
+ *          ...
+ *      ...
+ */
+
+#include <sys/errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <ldo/ldo.h>
+#include <ldo/state.h>
+#include <ldo/object.h>
+#include <ldo/sarry.h>
+#include <ldo/hash.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+
+#define PATHPAD(LEN) (((LEN) + 7) & ~(size_t)7)
+
+/*
+ * Parsed state entry, all pointers point
+ * into the state file buffer.
+ *
+ * @ent: Entry header.
+ * @path: Pathname (not NUL terminated).
+ * @hashes: Section content hashes.
+ * @packs: First packed static array.
+ */
+struct state_slot {
+    const struct ldo_state_ent *ent;
+    const char *path;
+    const uint64_t *hashes;
+    const char *packs;
+};
+
+/*
+ * @lfp: State file from the last link.
+ * @start_ns: Time this link started.
+ * @saved_ns: Time the last link started.
+ * @slots: Lookup table (open addressing).
+ * @nslots: Number of slots.
+ */
+static struct {
+    struct ldo_file *lfp;
+    uint64_t start_ns;
+    uint64_t saved_ns;
+    struct state_slot *slots;
+    size_t nslots;
+} state;
+
+static inline uint64_t
+ts_ns(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static struct state_slot *
+state_lookup(const char *path, size_t len)
+{
+    struct state_slot *slot;
+    size_t mask = state.nslots - 1;
+    size_t i;
+
+    i = ldo_hash64(path, len, 0) & mask;
+    for (;;) {
+        slot = &state.slots[i];
+        if (slot->ent == NULL)
+            return slot;
+        if (slot->ent->pathlen == len && memcmp(slot->path, path, len) == 0)
+            return slot;
+        i = (i + 1) & mask;
+    }
+}
+
+/*
+ * Check the packed static arrays of an entry,
+ * returns the size they take or a negative value
+ * if they are malformed.
+ *
+ * @ent: Entry header.
+ * @p: First packed array.
+ * @end: End of the state file.
+ */
+static ssize_t
+state_packs(const struct ldo_state_ent *ent, const char *p, const char *end)
+{
+    const struct ldo_state_pack *pk;
+    const uint64_t *blocks;
+    const char *start = p;
+    size_t i, j, left;
+
+    for (i = 0; i < ent->npack; ++i) {
+        if ((size_t)(end - p) < sizeof(*pk))
+            return -EINVAL;
+
+        pk = (const struct ldo_state_pack *)p;
+        left = (end - p - sizeof(*pk)) / sizeof(*blocks);
+        if (pk->sec >= ent->nsec || pk->nblock >= left)
+            return -EINVAL;
+
+        blocks = (const uint64_t *)(pk + 1);
+        left = (end - p) - sizeof(*pk) - (pk->nblock + 1) * sizeof(*blocks);
+        if (pk->size > left || PATHPAD(pk->size) > left)
+            return -EINVAL;
+        if (blocks[0] != 0 || blocks[pk->nblock] != pk->size)
+            return -EINVAL;
+        for (j = 0; j < pk->nblock; ++j) {
+            if (blocks[j] > blocks[j + 1])
+                return -EINVAL;
+        }
+
+        p += sizeof(*pk) + (pk->nblock + 1) * sizeof(*blocks);
+        p += PATHPAD(pk->size);
+    }
+
+    return p - start;
+}
+
+/*
+ * Index the entries of a state file, returns
+ * a negative value if it is malformed.
+ */
+static int
+state_parse(void)
+{
+    const struct ldo_state_hdr *hdr;
+    const struct ldo_state_ent *ent;
+    struct state_slot *slot;
+    const char *p, *end;
+    size_t i, need;
+    ssize_t len;
+
+    p = LDO_BUFSTREAM(state.lfp->data);
+    end = p + state.lfp->file_size;
+    hdr = (const struct ldo_state_hdr *)p;
+
+    if (state.lfp->file_size < sizeof(*hdr))
+        return -EINVAL;
+    if (hdr->magic != LDO_STATE_MAGIC || hdr->version != LDO_STATE_VERSION)
+        return -EINVAL;
+    if (hdr->block_size != SARRY_BLOCK_SIZE || hdr->codec != SARRY_CODEC_LZ4)
+        return -EINVAL;
+    if (hdr->count > state.lfp->file_size / sizeof(*ent))
+        return -EINVAL;
+
+    state.saved_ns = hdr->saved_ns;
+    state.nslots = 16;
+    while (state.nslots < hdr->count * 2)
+        state.nslots <<= 1;
+
+    state.slots = calloc(state.nslots, sizeof(*state.slots));
+    if (state.slots == NULL)
+        return -ENOMEM;
+
+    p += sizeof(*hdr);
+    for (i = 0; i < hdr->count; ++i) {
+        if ((size_t)(end - p) < sizeof(*ent))
+            return -EINVAL;
+
+        ent = (const struct ldo_state_ent *)p;
+        need = sizeof(*ent) + PATHPAD(ent->pathlen);
+        need += (size_t)ent->nsec * sizeof(uint64_t);
+        if ((size_t)(end - p) < need)
+            return -EINVAL;
+        if ((len = state_packs(ent, p + need, end)) < 0)
+            return len;
+
+        slot = state_lookup(p + sizeof(*ent), ent->pathlen);
+        slot->ent = ent;
+        slot->path = p + sizeof(*ent);
+        slot->hashes = (const uint64_t *)(slot->path + PATHPAD(ent->pathlen));
+        slot->packs = p + need;
+        p += need + len;
+    }
+
+    return 0;
+}
+
+/*
+ * Load the state of the last link, a missing
+ * state file just means everything is new.
+ *
+ * @path: State file pathname.
+ */
+int
+ldo_state_load(const char *path)
+{
+    struct timespec now;
+    int err;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    state.start_ns = ts_ns(&now);
+
+    if (access(path, R_OK) < 0) {
+        vlog("hash-cache: nothing in \"%s\" yet\n", path);
+        return 0;
+    }
+
+    if ((state.lfp = ldo_open(path, O_RDONLY)) == NULL) {
+        fprintf(stderr, "[warn] cannot read hash cache \"%s\"\n", path);
+        return 0;
+    }
+
+    if ((err = state_parse()) < 0) {
+        fprintf(stderr, "[warn] ignoring bad hash cache \"%s\"\n", path);
+        ldo_state_free();
+    }
+
+    return 0;
+}
+
+/*
+ * Copy a static array out of the state file, returns
+ * NULL if out of memory.
+ *
+ * @pk: Packed array.
+ */
+static struct sarry_pack *
+state_pack_copy(const struct ldo_state_pack *pk)
+{
+    const uint64_t *blocks = (const uint64_t *)(pk + 1);
+    struct sarry_pack *pp;
+
+    if ((pp = calloc(1, sizeof(*pp))) == NULL)
+        return NULL;
+
+    pp->blocks = malloc((pk->nblock + 1) * sizeof(*pp->blocks));
+    pp->cdata = malloc(pk->size + 1);
+    if (pp->blocks == NULL || pp->cdata == NULL) {
+        ldo_sarry_free(pp);
+        return NULL;
+    }
+
+    memcpy(pp->blocks, blocks, (pk->nblock + 1) * sizeof(*pp->blocks));
+    memcpy(pp->cdata, blocks + pk->nblock + 1, pk->size);
+    pp->size = pk->size;
+    pp->nblock = pk->nblock;
+    return pp;
+}
+
+/*
+ * Check an input against the last link and restore
+ * its section hashes and compressed static arrays if
+ * it did not change. Arrays that cannot be restored
+ * are compressed again. Returns 1 if the input is
+ * unchanged, otherwise 0.
+ *
+ * @in: Freshly loaded input.
+ */
+int
+ldo_state_apply(struct ldo_input *in)
+{
+    const struct ldo_state_ent *ent;
+    const struct ldo_state_pack *pk;
+    struct state_slot *slot;
+    struct ldo_isec *isp;
+    const char *p;
+    uint64_t mtime;
+    size_t i, nblock;
+
+    if (state.slots == NULL)
+        return 0;
+
+    slot = state_lookup(in->pathname, strlen(in->pathname));
+    if ((ent = slot->ent) == NULL)
+        return 0;
+
+    if (ent->size != in->lfp->file_size || ent->nsec != in->nsec)
+        return 0;
+
+    /*
+     * Anything touched after the last link started may
+     * have changed without its mtime moving, so treat it
+     * as changed. A content hash settles it either way.
+     */
+    mtime = ts_ns(&in->lfp->mtime);
+    if (in->hash != 0 && ent->hash != 0) {
+        if (in->hash != ent->hash)
+            return 0;
+    } else if (ent->mtime_ns != mtime || mtime >= state.saved_ns) {
+        return 0;
+    }
+
+    for (i = 0; i < in->nsec; ++i) {
+        in->isecs[i].hash = slot->hashes[i];
+    }
+
+    /* Inputs kept by the server still have theirs */
+    p = slot->packs;
+    for (i = 0; i < ent->npack; ++i) {
+        pk = (const struct ldo_state_pack *)p;
+        p += sizeof(*pk) + (pk->nblock + 1) * sizeof(uint64_t);
+        p += PATHPAD(pk->size);
+
+        isp = &in->isecs[pk->sec];
+        nblock = (isp->size + SARRY_BLOCK_SIZE - 1) / SARRY_BLOCK_SIZE;
+        if (isp->pack == NULL && pk->nblock == nblock)
+            isp->pack = state_pack_copy(pk);
+    }
+
+    in->flags |= LDO_IN_CACHED;
+    return 1;
+}
+
+static void
+state_hash_work(size_t idx, void *arg)
+{
+    struct ldo_input **inputs = arg;
+    struct ldo_input *in = inputs[idx];
+    size_t i;
+
+    for (i = 0; i < in->nsec; ++i) {
+        if ((in->isecs[i].flags & LDO_ISEC_DEAD) == 0)
+            ldo_isec_hash(&in->isecs[i]);
+    }
+}
+
+/*
+ * Write out the state of this link. The file is
+ * written next to `path' and renamed over it so a
+ * crash never leaves a torn state behind.
+ *
+ * @path: State file pathname.
+ * @iq: Every input of this link.
+ */
+int
+ldo_state_save(const char *path, struct ldo_inputq *iq)
+{
+    static const char pad[8] = { 0 };
+    struct ldo_state_hdr hdr;
+    struct ldo_state_ent ent;
+    struct ldo_state_pack pk;
+    struct ldo_input **inputs;
+    struct sarry_pack *pp;
+    struct ldo_input *in;
+    char tmppath[4096];
+    size_t i, j, ncached = 0;
+    uint64_t h;
+    FILE *fp;
+
+    inputs = calloc(iq->count + 1, sizeof(*inputs));
+    if (inputs == NULL)
+        return -ENOMEM;
+
+    i = 0;
+    TAILQ_FOREACH(in, &iq->q, link) {
+        inputs[i++] = in;
+        if ((in->flags & LDO_IN_CACHED) != 0)
+            ++ncached;
+    }
+
+    ldo_parallel_for(iq->count, state_hash_work, inputs);
+    vlog("hash-cache: %zu of %zu inputs unchanged\n", ncached, iq->count);
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+    if ((fp = fopen(tmppath, "wb")) == NULL) {
+        perror("fopen");
+        free(inputs);
+        return -EIO;
+    }
+
+    hdr.magic = LDO_STATE_MAGIC;
+    hdr.version = LDO_STATE_VERSION;
+    hdr.count = iq->count;
+    hdr.saved_ns = state.start_ns;
+    hdr.block_size = SARRY_BLOCK_SIZE;
+    hdr.codec = SARRY_CODEC_LZ4;
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+
+    for (i = 0; i < iq->count; ++i) {
+        in = inputs[i];
+        ent.pathlen = strlen(in->pathname);
+        ent.nsec = in->nsec;
+        ent.size = in->lfp->file_size;
+        ent.mtime_ns = ts_ns(&in->lfp->mtime);
+        ent.hash = in->hash;
+        ent.npack = 0;
+        for (j = 0; j < in->nsec; ++j) {
+            if (in->isecs[j].pack != NULL)
+                ++ent.npack;
+        }
+
+        fwrite(&ent, sizeof(ent), 1, fp);
+        fwrite(in->pathname, 1, ent.pathlen, fp);
+        fwrite(pad, 1, PATHPAD(ent.pathlen) - ent.pathlen, fp);
+        for (j = 0; j < in->nsec; ++j) {
+            h = in->isecs[j].hash;
+            fwrite(&h, sizeof(h), 1, fp);
+        }
+
+        for (j = 0; j < in->nsec; ++j) {
+            if ((pp = in->isecs[j].pack) == NULL)
+                continue;
+
+            pk.sec = j;
+            pk.nblock = pp->nblock;
+            pk.size = pp->size;
+            fwrite(&pk, sizeof(pk), 1, fp);
+            fwrite(pp->blocks, sizeof(*pp->blocks), pp->nblock + 1, fp);
+            fwrite(pp->cdata, 1, pp->size, fp);
+            fwrite(pad, 1, PATHPAD(pp->size) - pp->size, fp);
+        }
+    }
+
+    free(inputs);
+    if (ferror(fp) || fclose(fp) != 0) {
+        fprintf(stderr, "ldo_state_save: failed to write \"%s\"\n", tmppath);
+        unlink(tmppath);
+        return -EIO;
+    }
+
+    if (rename(tmppath, path) < 0) {
+        perror("rename");
+        unlink(tmppath);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/*
+ * Drop the state of the last link.
+ */
+void
+ldo_state_free(void)
+{
+    if (state.lfp != NULL)
+        ldo_close(state.lfp);
+
+    free(state.slots);
+    state.lfp = NULL;
+    state.slots = NULL;
+    state.nslots = 0;
+}
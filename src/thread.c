@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <ldo/thread.h>
+#include <ldo/cdefs.h>
+
+/*
+ * Worker pool shared by every parallel pass,
+ * the calling thread always takes part in a job
+ * so `ntd' only counts the extra workers.
+ *
+ * @td: Worker thread handles.
+ * @ntd: Number of worker threads.
+ * @lock: Protects everything below it.
+ * @job_lock: Held by the thread running a job.
+ * @work_cv: Signalled when a new job is posted.
+ * @done_cv: Signalled when the last worker finishes.
+ * @gen: Job generation, bumped for each job.
+ * @busy: Workers that have not finished the job yet.
+ * @stop: Set to tear the pool down.
+ * @fn: Work callback of the current job.
+ * @arg: Argument for `fn'.
+ * @n: Number of work items in the current job.
+ * @next: Next work item to hand out.
+ */
+static struct {
+    pthread_t *td;
+    size_t ntd;
+    pthread_mutex_t lock;
+    pthread_mutex_t job_lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+    uint64_t gen;
+    size_t busy;
+    int stop;
+    ldo_work_t fn;
+    void *arg;
+    size_t n;
+    atomic_size_t next;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .job_lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cv = PTHREAD_COND_INITIALIZER,
+    .done_cv = PTHREAD_COND_INITIALIZER
+};
+
+/* Set while the current thread is inside a job */
+static __thread int in_job = 0;
+
+static void
+pool_run(void)
+{
+    size_t i;
+
+    while ((i = atomic_fetch_add(&pool.next, 1)) < pool.n) {
+        pool.fn(i, pool.arg);
+    }
+}
+
+static void *
+pool_worker(void *p __unused)
+{
+    uint64_t seen = 0;
+
+    in_job = 1;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.gen == seen && !pool.stop)
+            pthread_cond_wait(&pool.work_cv, &pool.lock);
+        if (pool.stop)
+            break;
+
+        seen = pool.gen;
+        pthread_mutex_unlock(&pool.lock);
+        pool_run();
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.busy == 0)
+            pthread_cond_signal(&pool.done_cv);
+    }
+
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+/*
+ * Start the worker pool.
+ *
+ * @nthreads: Total number of threads to run jobs on,
+ *            including the caller (0 means one per CPU)
+ */
+int
+ldo_thread_init(size_t nthreads)
+{
+    long ncpu;
+    size_t i;
+
+    if (nthreads == 0) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (ncpu > 0) ? (size_t)ncpu : 1;
+    }
+    if (nthreads > LDO_MAX_THREADS)
+        nthreads = LDO_MAX_THREADS;
+
+    if (nthreads == 1)
+        return 0;
+
+    pool.td = calloc(nthreads - 1, sizeof(*pool.td));
+    if (pool.td == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < nthreads - 1; ++i) {
+        if (pthread_create(&pool.td[i], NULL, pool_worker, NULL) != 0) {
+            fprintf(stderr, "ldo_thread_init: only got %zu threads\n", i + 1);
+            break;
+        }
+        ++pool.ntd;
+    }
+
+    return 0;
+}
+
+/*
+ * Stop and join every worker thread.
+ */
+void
+ldo_thread_fini(void)
+{
+    size_t i;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.work_cv);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (i = 0; i < pool.ntd; ++i) {
+        pthread_join(pool.td[i], NULL);
+    }
+
+    free(pool.td);
+    pool.td = NULL;
+    pool.ntd = 0;
+    pool.stop = 0;
+}
+
+/*
+ * Returns the number of threads a job is
+ * spread across.
+ */
+size_t
+ldo_nthreads(void)
+{
+    return pool.ntd + 1;
+}
+
+/*
+ * Call `fn' for every index in [0, n) spread across
+ * the worker pool and return once all calls are done.
+ * Nested calls, or calls made while another thread
+ * owns the pool, just run serially.
+ *
+ * @n: Number of work items.
+ * @fn: Work callback.
+ * @arg: Argument for `fn'.
+ */
+void
+ldo_parallel_for(size_t n, ldo_work_t fn, void *arg)
+{
+    size_t i;
+
+    if (n == 0)
+        return;
+
+    if (pool.ntd == 0 || n == 1 || in_job ||
+        pthread_mutex_trylock(&pool.job_lock) != 0) {
+        for (i = 0; i < n; ++i)
+            fn(i, arg);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.n = n;
+    atomic_store(&pool.next, 0);
+    pool.busy = pool.ntd;
+    ++pool.gen;
+    pthread_cond_broadcast(&pool.work_cv);
+    pthread_mutex_unlock(&pool.lock);
+
+    in_job = 1;
+    pool_run();
+    in_job = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.busy != 0)
+        pthread_cond_wait(&pool.done_cv, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.job_lock);
+}
@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * io_uring backend for reading inputs. A batch of inputs
+ * is opened with one submission, stat'ed and checked for
+ * archive magic through the new descriptors with a second
+ * and read with a third, rather than taking three or more
+ * system calls per input. Only the raw system calls are
+ * used so there is nothing extra to link against.
+ */
+
+#define _GNU_SOURCE
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/errno.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <ldo/uring.h>
+#include <ldo/ldo.h>
+#include <ldo/archive.h>
+#include <ldo/cdefs.h>
+
+/* Two requests per input go in at once */
+#define URING_ENTRIES (LDO_URING_BATCH * 2)
+
+/* What a completion is for */
+#define URING_OPEN  0
+#define URING_STAT  1
+#define URING_READ  2
+#define URING_MAGIC 3
+
+#define URING_UDATA(IDX, OP)  (((uint64_t)(IDX) << 2) | (OP))
+
+/*
+ * A mapped submission and completion ring.
+ *
+ * @fd: Ring file descriptor (-1 if there is none).
+ * @sq_head: Submission queue head.
+ * @sq_tail: Submission queue tail.
+ * @sq_mask: Submission queue index mask.
+ * @sq_array: Submission queue index array.
+ * @sqes: Submission queue entries.
+ * @cq_head: Completion queue head.
+ * @cq_tail: Completion queue tail.
+ * @cq_mask: Completion queue index mask.
+ * @cqes: Completion queue entries.
+ * @sq_ring: Mapping of the submission ring.
+ * @cq_ring: Mapping of the completion ring.
+ * @sq_size: Size of `sq_ring'.
+ * @cq_size: Size of `cq_ring'.
+ * @sqe_size: Size of the `sqes' mapping.
+ * @pending: Submissions not handed to the kernel yet.
+ */
+struct uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqe_size;
+    unsigned pending;
+};
+
+/*
+ * Per input state of a batch.
+ *
+ * @fd: Opened file (or negative errno).
+ * @err: Result of statx (0 or negative errno).
+ * @nread: Result of the read (bytes or negative errno).
+ * @nmagic: Result of reading `magic' (bytes or negative errno).
+ * @stx: Result of statx.
+ * @magic: First bytes of the file.
+ * @buf: Buffer the file is read into.
+ */
+struct uring_file {
+    int fd;
+    int err;
+    int nread;
+    int nmagic;
+    struct statx stx;
+    char magic[SARMAG];
+    struct ldo_buffer *buf;
+};
+
+static struct uring ring = { .fd = -1 };
+
+/*
+ * Set up the ring. Returns 0 if io_uring can be
+ * used, otherwise callers stick with ldo_open().
+ */
+int
+ldo_uring_init(void)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+
+    if (ring.fd >= 0)
+        return 0;
+
+    memset(&p, 0, sizeof(p));
+    ring.fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (ring.fd < 0) {
+        vlog("io_uring: unavailable, using read()\n");
+        return -ENOSYS;
+    }
+
+    ring.sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring.cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        if (ring.cq_size > ring.sq_size)
+            ring.sq_size = ring.cq_size;
+        ring.cq_size = ring.sq_size;
+    }
+
+    ring.sq_ring = mmap(NULL, ring.sq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ring == MAP_FAILED)
+        goto fail;
+
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        ring.cq_ring = ring.sq_ring;
+    } else {
+        ring.cq_ring = mmap(NULL, ring.cq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ring == MAP_FAILED)
+            goto fail;
+    }
+
+    ring.sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqe_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) {
+        ring.sqes = NULL;
+        goto fail;
+    }
+
+    sq = ring.sq_ring;
+    cq = ring.cq_ring;
+    ring.sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring.sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring.cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    vlog("io_uring: %u entries\n", p.sq_entries);
+    return 0;
+fail:
+    vlog("io_uring: cannot map rings, using read()\n");
+    ldo_uring_fini();
+    return -ENOSYS;
+}
+
+void
+ldo_uring_fini(void)
+{
+    if (ring.fd < 0)
+        return;
+
+    if (ring.sqes != NULL)
+        munmap(ring.sqes, ring.sqe_size);
+    if (ring.cq_ring != NULL && ring.cq_ring != MAP_FAILED &&
+        ring.cq_ring != ring.sq_ring)
+        munmap(ring.cq_ring, ring.cq_size);
+    if (ring.sq_ring != NULL && ring.sq_ring != MAP_FAILED)
+        munmap(ring.sq_ring, ring.sq_size);
+
+    close(ring.fd);
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = -1;
+}
+
+/*
+ * Grab the next free submission entry.
+ */
+static struct io_uring_sqe *
+uring_sqe(uint8_t opcode, uint64_t udata)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, idx;
+
+    tail = *ring.sq_tail + ring.pending;
+    idx = tail & *ring.sq_mask;
+    sqe = &ring.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = udata;
+    ring.sq_array[idx] = idx;
+    ++ring.pending;
+    return sqe;
+}
+
+/*
+ * Hand every pending submission to the kernel and
+ * wait for all of them to complete, passing each
+ * completion to the batch.
+ *
+ * If the kernel refuses a submission, whatever it did
+ * not take yet is taken back and everything it did
+ * take is still waited for. Those point into the batch
+ * and its buffers, so nothing may be freed before they
+ * complete, and their completions must not turn up in
+ * the next batch either.
+ */
+static int
+uring_run(struct uring_file *files)
+{
+    struct io_uring_cqe *cqe;
+    struct uring_file *fp;
+    unsigned head, start, taken, n = ring.pending, done = 0;
+    int ret, res, err = 0;
+
+    start = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(ring.sq_tail, *ring.sq_tail + n, __ATOMIC_RELEASE);
+    ring.pending = 0;
+
+    for (;;) {
+        taken = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) - start;
+        if (done == taken && (err < 0 || taken == n))
+            break;
+
+        ret = syscall(__NR_io_uring_enter, ring.fd, err ? 0 : n - taken, 1,
+            IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR) {
+            if (err == 0) {
+                err = -errno;
+                /* Nothing polls the ring, so the rest is still ours */
+                __atomic_store_n(ring.sq_tail, start + taken,
+                    __ATOMIC_RELEASE);
+            } else {
+                /* Cannot wait in the kernel, completions still land */
+                usleep(1000);
+            }
+        }
+
+        head = *ring.cq_head;
+        while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+            cqe = &ring.cqes[head & *ring.cq_mask];
+            fp = &files[cqe->user_data >> 2];
+            res = cqe->res;
+
+            switch (cqe->user_data & 3) {
+            case URING_OPEN:
+                fp->fd = res;
+                break;
+            case URING_STAT:
+                fp->err = (res < 0) ? res : 0;
+                break;
+            case URING_READ:
+                fp->nread = res;
+                break;
+            case URING_MAGIC:
+                fp->nmagic = res;
+                break;
+            }
+
+            ++head;
+            ++done;
+        }
+
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return err;
+}
+
+/*
+ * Make an LDO file handle out of a batch entry, reading
+ * whatever a short read left behind synchronously.
+ */
+static struct ldo_file *
+uring_file(struct uring_file *fp)
+{
+    struct ldo_file *lfp;
+    size_t size = fp->stx.stx_size;
+    size_t done;
+    ssize_t ret;
+
+    if (fp->nread < 0)
+        return NULL;
+
+    done = fp->nread;
+    while (done < size) {
+        ret = pread(fp->fd, LDO_BUFSTREAM(fp->buf) + done, size - done, done);
+        if (ret <= 0)
+            return NULL;
+        done += ret;
+    }
+
+    if ((lfp = calloc(1, sizeof(*lfp))) == NULL)
+        return NULL;
+
+    close(fp->fd);
+    lfp->fd = -1;
+    lfp->file_size = size;
+    lfp->mtime.tv_sec = fp->stx.stx_mtime.tv_sec;
+    lfp->mtime.tv_nsec = fp->stx.stx_mtime.tv_nsec;
+    lfp->data = fp->buf;
+    return lfp;
+}
+
+/*
+ * Returns true if a batch entry starts with archive
+ * magic. Those are left to ldo_open() to be mapped,
+ * reading them in through the ring would touch every
+ * member.
+ */
+static int
+uring_isarchive(const struct uring_file *fp)
+{
+    if (fp->nmagic != SARMAG)
+        return 0;
+
+    return memcmp(fp->magic, ARMAG, SARMAG) == 0 ||
+        memcmp(fp->magic, THINMAG, SARMAG) == 0;
+}
+
+/*
+ * Open and read a batch of inputs. Inputs the ring
+ * could not handle are opened with ldo_open() so the
+ * usual errors are reported. Returns -ENOSYS if there
+ * is no ring, in which case nothing was touched.
+ *
+ * @paths: Pathnames of the inputs.
+ * @lfps: Returns a file handle (or NULL) per input.
+ * @n: Number of inputs, at most LDO_URING_BATCH.
+ */
+int
+ldo_uring_open(const char *const *paths, struct ldo_file **lfps, size_t n)
+{
+    struct uring_file files[LDO_URING_BATCH];
+    struct io_uring_sqe *sqe;
+    struct uring_file *fp;
+    size_t i;
+    int err;
+
+    if (ring.fd < 0)
+        return -ENOSYS;
+    if (n > LDO_URING_BATCH)
+        return -EINVAL;
+
+    memset(files, 0, n * sizeof(*files));
+    for (i = 0; i < n; ++i) {
+        files[i].fd = -1;
+        sqe = uring_sqe(IORING_OP_OPENAT, URING_UDATA(i, URING_OPEN));
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uintptr_t)paths[i];
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    if ((err = uring_run(files)) < 0)
+        goto fallback;
+
+    /* Stat what was opened, not the path, it may have changed since */
+    for (i = 0; i < n; ++i) {
+        fp = &files[i];
+        if (fp->fd < 0)
+            continue;
+
+        sqe = uring_sqe(IORING_OP_STATX, URING_UDATA(i, URING_STAT));
+        sqe->fd = fp->fd;
+        sqe->addr = (uintptr_t)"";
+        sqe->statx_flags = AT_EMPTY_PATH;
+        sqe->len = STATX_SIZE | STATX_MTIME;
+        sqe->off = (uintptr_t)&fp->stx;
+
+        sqe = uring_sqe(IORING_OP_READ, URING_UDATA(i, URING_MAGIC));
+        sqe->fd = fp->fd;
+        sqe->addr = (uintptr_t)fp->magic;
+        sqe->len = SARMAG;
+        sqe->off = 0;
+    }
+
+    if ((err = uring_run(files)) < 0)
+        goto fallback;
+
+    for (i = 0; i < n; ++i) {
+        fp = &files[i];
+        if (fp->fd < 0 || fp->err < 0 || uring_isarchive(fp))
+            continue;
+        if ((fp->buf = ldo_allocz(fp->stx.stx_size)) == NULL)
+            continue;
+
+        sqe = uring_sqe(IORING_OP_READ, URING_UDATA(i, URING_READ));
+        sqe->fd = fp->fd;
+        sqe->addr = (uintptr_t)LDO_BUFSTREAM(fp->buf);
+        sqe->len = fp->stx.stx_size;
+        sqe->off = 0;
+    }
+
+    err = uring_run(files);
+fallback:
+    for (i = 0; i < n; ++i) {
+        fp = &files[i];
+        lfps[i] = NULL;
+
+        if (err == 0 && fp->fd >= 0 && fp->err == 0 && fp->buf != NULL)
+            lfps[i] = uring_file(fp);
+        if (lfps[i] != NULL)
+            continue;
+
+        if (fp->buf != NULL)
+            ldo_free(fp->buf);
+        if (fp->fd >= 0)
+            close(fp->fd);
+
+        lfps[i] = ldo_open(paths[i], O_RDONLY);
+    }
+
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Fuzz harness for the loader. Every input is written
+ * to a memfd and linked on its own the way ldo links
+ * a command line: listed in a manifest, loaded with
+ * ldo_load_all() (io_uring if the kernel has it, the
+ * ELF and archive checks) and taken through every
+ * link pass up to writing the image, or released with
+ * ldo_fini() if it did not load. Built with
+ * -DLDO_LIBFUZZER it is a libFuzzer target, otherwise
+ * it is a driver that runs each file it is given, or
+ * stdin, which is what AFL wants (persistent mode
+ * under afl-clang-fast). `make fuzz-seeds' puts seeds
+ * in bin/corpus/: one with a compressed static array
+ * and copies of it with a header byte broken for each
+ * kind of ELF file ldo must turn away.
+ *
+ *      make fuzz && bin/fuzz_load bin/corpus/
+ *      make bin/fuzz_load_afl fuzz-seeds CC=afl-clang-fast
+ *      afl-fuzz -i bin/corpus -o findings bin/fuzz_load_afl
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ldo/ldo.h>
+#include <ldo/manifest.h>
+#include <ldo/thread.h>
+
+/* Largest input run, bigger ones are cut short */
+#define FUZZ_MAXLEN (1 << 20)
+
+static ldo_flags_t flags;
+static struct ldo_opts opts;
+static int in_fd = -1;
+static char in_path[64];
+static char out_dir[] = "/tmp/fuzz_load.XXXXXX";
+static char out_path[sizeof(out_dir) + 4];
+
+/*
+ * Stand in for the runtime flags main.c would parse,
+ * turn on every pass that looks at section contents.
+ */
+ldo_flags_t
+ldo_rtflags(void)
+{
+    return flags;
+}
+
+const struct ldo_opts *
+ldo_rtopts(void)
+{
+    return &opts;
+}
+
+static void
+fuzz_cleanup(void)
+{
+    unlink(out_path);
+    rmdir(out_dir);
+}
+
+/*
+ * Inputs go through a memfd. The image is renamed
+ * into place like any other, so it goes in a
+ * directory of its own.
+ */
+static int
+fuzz_init(void)
+{
+    if ((in_fd = memfd_create("fuzz-in", 0)) < 0) {
+        perror("memfd_create");
+        return -1;
+    }
+    if (mkdtemp(out_dir) == NULL) {
+        perror("mkdtemp");
+        return -1;
+    }
+
+    snprintf(in_path, sizeof(in_path), "/proc/self/fd/%d", in_fd);
+    snprintf(out_path, sizeof(out_path), "%s/out", out_dir);
+    atexit(fuzz_cleanup);
+
+    flags = LDO_F_ICF | LDO_F_ICF_ALL | LDO_F_BUILD_ID | LDO_F_ZDEBUG |
+        LDO_F_TAIL_MERGE;
+    opts.out_path = out_path;
+    opts.readahead = 0;
+    return ldo_thread_init(1);
+}
+
+/*
+ * Link one input.
+ */
+static void
+fuzz_one(const uint8_t *data, size_t size)
+{
+    struct ldo_manifest mf = { NULL, 0, 0 };
+
+    if (size > FUZZ_MAXLEN)
+        size = FUZZ_MAXLEN;
+
+    if (ftruncate(in_fd, 0) < 0 || pwrite(in_fd, data, size, 0) !=
+        (ssize_t)size)
+        abort();
+
+    if (ldo_manifest_add(&mf, in_path, size, 0) < 0 || ldo_init(mf.count) < 0)
+        abort();
+
+    if (ldo_load_all(&mf) == 0) {
+        ldo_link();
+    } else {
+        ldo_fini();
+    }
+    ldo_manifest_free(&mf);
+}
+
+#if defined(LDO_LIBFUZZER)
+int
+LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+
+    if (fuzz_init() < 0)
+        abort();
+    return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    fuzz_one(data, size);
+    return 0;
+}
+#else
+/*
+ * Read all of a file into `buf', returns its
+ * length or -1.
+ */
+static ssize_t
+fuzz_read(int fd, uint8_t *buf)
+{
+    size_t len = 0;
+    ssize_t n;
+
+    while (len < FUZZ_MAXLEN) {
+        if ((n = read(fd, buf + len, FUZZ_MAXLEN - len)) < 0)
+            return -1;
+        if (n == 0)
+            break;
+        len += n;
+    }
+
+    return len;
+}
+
+int
+main(int argc, char **argv)
+{
+    static uint8_t buf[FUZZ_MAXLEN];
+    ssize_t len;
+    int i, fd;
+
+    if (fuzz_init() < 0)
+        return 1;
+
+    if (argc < 2) {
+#if defined(__AFL_LOOP)
+        while (__AFL_LOOP(1000)) {
+#endif  /* __AFL_LOOP */
+            if ((len = fuzz_read(0, buf)) < 0)
+                return 1;
+            fuzz_one(buf, len);
+#if defined(__AFL_LOOP)
+        }
+#endif  /* __AFL_LOOP */
+        return 0;
+    }
+
+    for (i = 1; i < argc; ++i) {
+        if ((fd = open(argv[i], O_RDONLY)) < 0) {
+            perror(argv[i]);
+            return 1;
+        }
+
+        len = fuzz_read(fd, buf);
+        close(fd);
+        if (len < 0) {
+            perror(argv[i]);
+            return 1;
+        }
+
+        fprintf(stderr, "fuzz_load: %s\n", argv[i]);
+        fuzz_one(buf, len);
+    }
+
+    return 0;
+}
+#endif  /* LDO_LIBFUZZER */
@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Relaxation test: link a fixture and check the .text of the
+# output byte for byte against the .expect.text section of the
+# fixture, which spells out every instruction as it has to look
+# once relaxed. Only readelf is used so the fixture can be for
+# any machine.
+#
+# Usage: tests/relax.sh <ldo> <fixture.o> <output>
+
+set -e
+
+LDO=$1
+OBJ=$2
+OUT=$3
+
+# Raw contents of a section
+section() {
+    local off size
+
+    read -r off size < <(readelf -S -W "$1" | sed -n 's/^ *\[ *[0-9]*\] //p' |
+        awk -v s="$2" '$1 == s { print $4, $5 }')
+    if [ -z "$off" ]; then
+        echo "$1: no $2 section" >&2
+        return 1
+    fi
+    dd if="$1" bs=1 skip=$((16#$off)) count=$((16#$size)) status=none
+}
+
+"$LDO" -o "$OUT" "$OBJ"
+section "$OUT" .text > "$OUT.text"
+section "$OBJ" .expect.text > "$OUT.expect"
+if ! cmp "$OUT.text" "$OUT.expect"; then
+    echo "$OBJ: relaxed .text differs from .expect.text" >&2
+    exit 1
+fi
+
+echo "$OBJ: relaxed .text ok"
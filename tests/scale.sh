@@ -0,0 +1,91 @@
+#!/bin/bash
+#
+# Scale test for the loader: link a very large number of
+# tiny objects, then a few objects of several GiB each.
+# Fails if ldo fails or the output is missing data, and
+# prints how long each link took.
+#
+# Usage: tests/scale.sh [ldo]
+#
+#   SCALE_DIR       Scratch directory (default: /tmp/ldo-scale)
+#   SCALE_TINY      Number of tiny objects (default: 100000)
+#   SCALE_BIG       Number of big objects (default: 3)
+#   SCALE_BIG_MB    Size of each big object in MiB (default: 2560)
+#   SCALE_FLAGS     Extra ldo flags (e.g. -j8)
+
+set -e
+
+LDO=$(realpath "${1:-bin/ldo}")
+DIR=${SCALE_DIR:-/tmp/ldo-scale}
+TINY=${SCALE_TINY:-100000}
+BIG=${SCALE_BIG:-3}
+BIG_MB=${SCALE_BIG_MB:-2560}
+
+# Run a link and report how long it took
+timed_link() {
+    local TIMEFORMAT="$1: %R s"
+    shift
+
+    time "$LDO" -v $SCALE_FLAGS "$@" | grep -E "^load:" || true
+}
+
+# Size of an output section in bytes
+section_size() {
+    local hex
+
+    hex=$(objdump -h "$1" | awk -v s="$2" '$2 == s { print $3 }')
+    echo $((16#${hex:-0}))
+}
+
+mkdir -p "$DIR"
+cd "$DIR"
+
+echo "Making $TINY tiny objects..."
+cat > tiny.s <<'ASM'
+    .text
+    .globl f
+f:
+    ret
+    .section .rodata.str1.1, "aMS", @progbits, 1
+    .asciz "tiny"
+    .data
+    .quad 1
+ASM
+as tiny.s -o tiny.o
+size=$(stat -c %s tiny.o)
+
+# One concatenated file split back up, much faster than a copy each
+rm -rf tiny
+mkdir tiny
+yes tiny.o | head -n "$TINY" | xargs cat > tiny.all
+split -d -a 7 -b "$size" tiny.all tiny/t
+rm tiny.all
+ls -1 tiny/ | sed 's|^|tiny/|' > tiny.rsp
+
+timed_link "tiny x $TINY" -o tiny.out @tiny.rsp
+got=$(section_size tiny.out .text)
+if [ "$got" -lt "$TINY" ]; then
+    echo "tiny: .text is $got bytes, expected at least $TINY" >&2
+    exit 1
+fi
+
+echo "Making $BIG objects of $BIG_MB MiB..."
+big=()
+for i in $(seq "$BIG"); do
+    if [ ! -f "big$i.o" ]; then
+        printf '    .section .rodata.big%d, "a"\n    .fill %d, 1, %d\n' \
+            "$i" $((BIG_MB << 20)) "$i" > "big$i.s"
+        as "big$i.s" -o "big$i.o"
+    fi
+    big+=("big$i.o")
+done
+
+timed_link "big x $BIG" -o big.out "${big[@]}"
+got=$(section_size big.out .rodata)
+want=$((BIG * (BIG_MB << 20)))
+if [ "$got" -ne "$want" ]; then
+    echo "big: .rodata is $got bytes, expected $want" >&2
+    exit 1
+fi
+
+echo "ok"
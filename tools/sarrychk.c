@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2025 Ian Marco Moffett and the Osmora Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of Hyra nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Static array checker. Reads every .static_array.*
+ * section of the inputs of a link back out of its
+ * output, through each of the runtime's read paths,
+ * and fails if any byte differs. With -b it also
+ * measures how fast the arrays decompress for each
+ * LZ4 level and block size.
+ *
+ * Usage: sarrychk [-b] <output> <input.o>...
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <ldo/elf.h>
+#include <sarry_rt.h>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zlib.h>
+
+/* Random reads per array */
+#define CHK_READS   256
+
+/* Spend at least this long timing each setting */
+#define BENCH_NS    200000000ULL
+
+/*
+ * Compression setting to benchmark.
+ *
+ * @codec: Codec name.
+ * @level: Level (acceleration for plain LZ4).
+ * @hc: Use the high compression encoder.
+ */
+struct bench_level {
+    const char *codec;
+    int level;
+    int hc;
+};
+
+static const struct bench_level levels[] = {
+    { "lz4",    1,  0 },
+    { "lz4",    8,  0 },
+    { "lz4hc",  4,  1 },
+    { "lz4hc",  9,  1 },
+    { "lz4hc",  12, 1 },
+};
+
+static const size_t bsizes[] = {
+    16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024
+};
+
+#define NLEVELS (sizeof(levels) / sizeof(levels[0]))
+#define NBSIZES (sizeof(bsizes) / sizeof(bsizes[0]))
+
+/*
+ * An array found in an input object.
+ *
+ * @name: Array name.
+ * @data: Original bytes.
+ * @size: Size of `data'.
+ */
+struct chk_array {
+    const char *name;
+    const char *data;
+    size_t size;
+};
+
+static struct chk_array *arrays;
+static size_t narray, cap;
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Inflate a compressed input section, returns
+ * NULL if it is broken or out of memory.
+ *
+ * @data: Section contents, from the Elf64_Chdr on.
+ * @size: Size of `data', set to the inflated size.
+ */
+static char *
+chk_inflate(const char *data, size_t *size)
+{
+    Elf64_Chdr chdr;
+    uLongf len;
+    char *buf;
+
+    if (*size < sizeof(chdr))
+        return NULL;
+    memcpy(&chdr, data, sizeof(chdr));
+    if (chdr.ch_type != ELFCOMPRESS_ZLIB)
+        return NULL;
+    if ((buf = malloc(chdr.ch_size ? chdr.ch_size : 1)) == NULL)
+        return NULL;
+
+    len = chdr.ch_size;
+    if (uncompress((Bytef *)buf, &len, (const Bytef *)data + sizeof(chdr),
+        *size - sizeof(chdr)) != Z_OK || len != chdr.ch_size) {
+        free(buf);
+        return NULL;
+    }
+
+    *size = len;
+    return buf;
+}
+
+/*
+ * Collect the static arrays of one input
+ * object, first definition wins like in ldo.
+ *
+ * @path: Object pathname.
+ */
+static int
+chk_input(const char *path)
+{
+    const Elf64_Ehdr *eh;
+    const Elf64_Shdr *shdrs, *shdr;
+    const char *map, *name;
+    struct stat st;
+    size_t i, j;
+    void *p;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    eh = (const Elf64_Ehdr *)map;
+    if ((size_t)st.st_size < sizeof(*eh) ||
+        memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_shoff + eh->e_shnum * sizeof(*shdrs) > (size_t)st.st_size ||
+        eh->e_shstrndx >= eh->e_shnum) {
+        fprintf(stderr, "%s: not a 64-bit ELF object\n", path);
+        return -1;
+    }
+
+    shdrs = (const Elf64_Shdr *)(map + eh->e_shoff);
+    for (i = 0; i < eh->e_shnum; ++i) {
+        shdr = &shdrs[i];
+        name = map + shdrs[eh->e_shstrndx].sh_offset + shdr->sh_name;
+        if (shdr->sh_type != SHT_PROGBITS)
+            continue;
+        if (strncmp(name, SARRY_PREFIX, sizeof(SARRY_PREFIX) - 1) != 0)
+            continue;
+
+        name += sizeof(SARRY_PREFIX) - 1;
+        for (j = 0; j < narray; ++j) {
+            if (strcmp(arrays[j].name, name) == 0)
+                break;
+        }
+        if (j < narray)
+            continue;
+
+        if (narray == cap) {
+            cap = cap ? cap * 2 : 16;
+            if ((p = realloc(arrays, cap * sizeof(*arrays))) == NULL) {
+                fprintf(stderr, "sarrychk: out of memory\n");
+                return -1;
+            }
+            arrays = p;
+        }
+
+        arrays[narray].name = name;
+        arrays[narray].data = map + shdr->sh_offset;
+        arrays[narray].size = shdr->sh_size;
+        if ((shdr->sh_flags & SHF_COMPRESSED) != 0) {
+            arrays[narray].data = chk_inflate(arrays[narray].data,
+                &arrays[narray].size);
+            if (arrays[narray].data == NULL) {
+                fprintf(stderr, "%s: %s: bad compressed section\n", path,
+                    name);
+                return -1;
+            }
+        }
+        ++narray;
+    }
+
+    return 0;
+}
+
+/*
+ * Check one array against the output through
+ * sarry_get(), sarry_read() and sarry_map().
+ */
+static int
+chk_array(struct sarry_ctx *cp, const struct chk_array *ap)
+{
+    const struct sarry_ent *ep;
+    const char *p;
+    size_t i, off, len;
+    ssize_t n;
+    char *buf;
+    int err = 0;
+
+    if ((ep = sarry_find(cp, ap->name)) == NULL) {
+        fprintf(stderr, "%s: missing from output\n", ap->name);
+        return -1;
+    }
+
+    if (ep->real_size != ap->size) {
+        fprintf(stderr, "%s: size %zu, expected %zu\n", ap->name,
+            (size_t)ep->real_size, ap->size);
+        return -1;
+    }
+
+    p = sarry_get(cp, ep);
+    if (p == NULL || memcmp(p, ap->data, ap->size) != 0) {
+        fprintf(stderr, "%s: sarry_get() differs\n", ap->name);
+        err = -1;
+    }
+
+    p = sarry_map(cp, ep);
+    if (p == NULL || memcmp(p, ap->data, ap->size) != 0) {
+        fprintf(stderr, "%s: sarry_map() differs\n", ap->name);
+        err = -1;
+    }
+
+    if ((buf = malloc(ap->size + 1)) == NULL)
+        return -1;
+
+    /* Fixed seed, so a failure can be reproduced */
+    srand(ap->size);
+    for (i = 0; i < CHK_READS && err == 0; ++i) {
+        off = rand() % (ap->size + 1);
+        len = rand() % (ap->size - off + 1);
+        n = sarry_read(cp, ep, buf, off, len);
+        if (n != (ssize_t)len || memcmp(buf, ap->data + off, len) != 0) {
+            fprintf(stderr, "%s: sarry_read() at %zu+%zu differs\n",
+                ap->name, off, len);
+            err = -1;
+        }
+    }
+
+    free(buf);
+    return err;
+}
+
+/*
+ * Decompress every array split into `bs' byte
+ * blocks at one level, print ratio and GB/s.
+ */
+static int
+bench_one(const struct bench_level *lp, size_t bs)
+{
+    size_t i, j, blen, total = 0, ctotal = 0, nblk = 0, reps = 0;
+    size_t bound = LZ4_compressBound(bs);
+    char **cbufs, *out;
+    int *clens, n;
+    uint64_t start, ns;
+
+    for (i = 0; i < narray; ++i) {
+        nblk += (arrays[i].size + bs - 1) / bs;
+    }
+
+    cbufs = calloc(nblk + 1, sizeof(*cbufs));
+    clens = calloc(nblk + 1, sizeof(*clens));
+    out = malloc(bs);
+    if (cbufs == NULL || clens == NULL || out == NULL)
+        return -1;
+
+    nblk = 0;
+    for (i = 0; i < narray; ++i) {
+        for (j = 0; j < arrays[i].size; j += bs, ++nblk) {
+            blen = arrays[i].size - j;
+            if (blen > bs)
+                blen = bs;
+            if ((cbufs[nblk] = malloc(bound)) == NULL)
+                return -1;
+            if (lp->hc) {
+                n = LZ4_compress_HC(arrays[i].data + j, cbufs[nblk], blen,
+                    bound, lp->level);
+            } else {
+                n = LZ4_compress_fast(arrays[i].data + j, cbufs[nblk], blen,
+                    bound, lp->level);
+            }
+            clens[nblk] = n;
+            total += blen;
+            ctotal += n;
+        }
+    }
+
+    start = now_ns();
+    do {
+        for (i = 0; i < nblk; ++i) {
+            LZ4_decompress_safe(cbufs[i], out, clens[i], bs);
+        }
+        ++reps;
+        ns = now_ns() - start;
+    } while (ns < BENCH_NS);
+
+    printf("%-6s %5d %8zu %7.2f %8.2f\n", lp->codec, lp->level, bs,
+        ctotal ? (double)total / ctotal : 0.0,
+        (double)total * reps / ns);
+
+    for (i = 0; i < nblk; ++i) {
+        free(cbufs[i]);
+    }
+    free(cbufs);
+    free(clens);
+    free(out);
+    return 0;
+}
+
+/*
+ * Time reading every array of the output as it
+ * was linked, through the runtime.
+ */
+static void
+bench_output(struct sarry_ctx *cp)
+{
+    const struct sarry_ent *ep;
+    size_t i, total = 0, reps = 0;
+    uint64_t start, ns;
+    char *buf;
+
+    start = now_ns();
+    do {
+        for (i = 0; i < narray; ++i) {
+            ep = sarry_find(cp, arrays[i].name);
+            if ((buf = malloc(ep->real_size + 1)) == NULL)
+                return;
+            sarry_read(cp, ep, buf, 0, ep->real_size);
+            total += ep->real_size;
+            free(buf);
+        }
+        ++reps;
+        ns = now_ns() - start;
+    } while (ns < BENCH_NS);
+
+    printf("output: %zu arrays, %.2f GB/s through sarry_read()\n",
+        narray, (double)total / ns);
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-b] <output> <input.o>...\n", argv0);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct sarry_ctx ctx;
+    size_t i, j, bytes = 0;
+    int c, bench = 0, err = 0;
+
+    while ((c = getopt(argc, argv, "bh")) != -1) {
+        switch (c) {
+        case 'b':
+            bench = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if ((err = sarry_open(&ctx, argv[optind])) < 0) {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(-err));
+        return 1;
+    }
+
+    for (i = optind + 1; i < (size_t)argc; ++i) {
+        if (chk_input(argv[i]) < 0)
+            return 1;
+    }
+
+    err = 0;
+    for (i = 0; i < narray; ++i) {
+        if (chk_array(&ctx, &arrays[i]) < 0)
+            err = 1;
+        bytes += arrays[i].size;
+    }
+
+    if (ctx.hdr->narray != narray) {
+        fprintf(stderr, "%s: %u arrays, expected %zu\n", argv[optind],
+            ctx.hdr->narray, narray);
+        err = 1;
+    }
+
+    printf("%s: %zu arrays, %zu bytes, %s\n", argv[optind], narray, bytes,
+        err ? "FAILED" : "ok");
+    if (err || !bench)
+        goto done;
+
+    printf("%-6s %5s %8s %7s %8s\n", "codec", "level", "block", "ratio",
+        "GB/s");
+    for (i = 0; i < NLEVELS; ++i) {
+        for (j = 0; j < NBSIZES; ++j) {
+            if (bench_one(&levels[i], bsizes[j]) < 0) {
+                fprintf(stderr, "sarrychk: out of memory\n");
+                err = 1;
+                goto done;
+            }
+        }
+    }
+
+    bench_output(&ctx);
+done:
+    sarry_close(&ctx);
+    return err;
+}